@@ -0,0 +1,95 @@
+/*
+ * Compile time against DFA size.
+ *      cc -std=c99 -O2 -pthread -I.. -o bench-compile bench-compile.c ../limregex.c
+ *      ./bench-compile
+ * Prints the DFA states before and after minimization, the
+ * table rows (DFA states and search states) and the time
+ * of a compile, time per row stays flat when compile time
+ * is linear in the states.
+ *
+ * Copyright (C) 2015 ZHANG X. <201560039.uibe.edu.cn>
+ * Released under the MIT licence, see limregex.c.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "limregex.h"
+
+#define REGEXP_MAX (1<<20)
+
+char regexp[REGEXP_MAX];
+
+static double now(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/*  "w0|w1|..." of n words, a state a letter   */
+static void words(int n){
+    char *c = regexp;
+    for(int i = 0; i<n; i++)
+        c += sprintf(c, "%sw%dx%dy", i? "|": "", i*7919 % 100003, i);
+}
+
+/*  "(w0|w1|...)*", every state closes over all words   */
+static void star_words(int n){
+    char *c = regexp + sprintf(regexp, "(");
+    for(int i = 0; i<n; i++)
+        c += sprintf(c, "%sw%dx%dy", i? "|": "", i*7919 % 100003, i);
+    sprintf(c, ")*");
+}
+
+/*  "(a*b*c*...)*" of n < 224 bytes, long epsilon closures,
+ *  a row has a column a byte, so time per row grows with n  */
+static void stars(int n){
+    char *c = regexp + sprintf(regexp, "(");
+    for(int i = 0; i<n; i++)
+        c += sprintf(c, "\\x%02x*", 0x20 + i);
+    sprintf(c, ")*");
+}
+
+/*  "(a|b)*a(a|b)(a|b)...", 2^(n+1) states  */
+static void nth_last(int n){
+    char *c = regexp + sprintf(regexp, "(a|b)*a");
+    for(int i = 0; i<n; i++)c += sprintf(c, "(a|b)");
+}
+
+/*  "a\d*b\d*c..." of n letters   */
+static void chain(int n){
+    char *c = regexp;
+    for(int i = 0; i<n; i++)
+        c += sprintf(c, "%c\\d*", 'a' + i % 26);
+}
+
+static void bench(const char *name, void (*make)(int), int from, int to, int step){
+    struct limregex_context *context = limregex_context_new(NULL);
+    printf("%-10s %10s %8s %8s %8s %12s %12s\n", name, "n", "subsets", "states", "rows", "ms", "us/row");
+    for(int n = from; context && n <= to; n = step? n + step: n * 2){
+        make(n);
+        double t = now();
+        int len = limregex_context_compile(context, regexp, strlen(regexp), LIMREGEX_TABLE);
+        t = now() - t;
+        int *table = (len > 0)? malloc(len * sizeof(int)): NULL;
+        if(!table)break;
+        limregex_context_emit(context, table, len);
+        int states[2];
+        limregex_dfa_states(states, len, regexp);
+        printf("%-10s %10d %8d %8d %8d %12.3f %12.3f\n", name, n, states[0], states[1],
+                table[0], t * 1e3, t * 1e6 / table[0]);
+        free(table);
+    }
+    limregex_context_free(context);
+}
+
+int main(void){
+    bench("words", words, 16, 1024, 0);
+    bench("star_words", star_words, 16, 1024, 0);
+    bench("stars", stars, 16, 208, 32);
+    bench("chain", chain, 16, 1024, 0);
+    bench("nth_last", nth_last, 2, 10, 1);
+    return EXIT_SUCCESS;
+}
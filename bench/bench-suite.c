@@ -0,0 +1,460 @@
+/*
+ * Compile and match throughput on synthetic corpora, against
+ * POSIX regcomp()/regexec() of the C library.
+ *      cc -std=c99 -O2 -pthread -I.. -o bench-suite bench-suite.c ../limregex.c
+ *      ./bench-suite [-b corpus bytes] [-r rounds] [-s seed] [-p] > result.tsv
+ * Each corpus is made from the seed alone, so a run is the
+ * same input on every machine. Every pattern of the catalogue
+ * counts the lines of every corpus it matches, by:
+ *      vm      limregexcl() of ".*(pattern)", limregexec_mode_n()
+ *              LIMREGEX_IS_MATCH on each line
+ *      table   limregex_compile_table(), limregex_search_n()
+ *              on each line
+ *      batch   limregex_compile_table() of ".*(pattern)",
+ *              limregex_exec_batch() on all the lines
+ *      jit     limregex_jit_compile() of ".*(pattern)",
+ *              limregex_jit_exec_mode_n() LIMREGEX_IS_MATCH
+ *              on each line
+ *      posix   regcomp(), regexec() on each line
+ * Output is a line of tab separated fields a run, after a
+ * header line: compile time of one program, the best of the
+ * rounds over the corpus, MB/s and ns per matched line.
+ * -p adds cycles and branch misses of the best round by
+ * perf_event_open(), "-" where it is not allowed. Engines
+ * counting other matches than the first one are reported
+ * on stderr, so are engines taking UTF-8, whole or cut
+ * short, other than utf8Width() of limregex.c, checked
+ * before the runs.
+ *
+ * Copyright (C) 2015 ZHANG X. <201560039.uibe.edu.cn>
+ * Released under the MIT licence, see limregex.c.
+ */
+
+#define _DEFAULT_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <regex.h>
+#include "limregex.h"
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#define CORPUS_BYTES (1<<22)
+#define ROUNDS 5
+#define PROGRAM_MAX (1<<22)
+#define PATTERN_MAX 256
+/*  compile is repeated for at least this long  */
+#define COMPILE_NS 20000000LL
+
+/*  The same pattern in limregex and in POSIX ERE syntax    */
+struct pattern{
+    const char *name;
+    const char *limregex;
+    const char *posix;
+};
+
+static const struct pattern catalogue[] = {
+    {"literal", "ERROR", "ERROR"},
+    {"literal_rare", "deadlock", "deadlock"},
+    {"alternation", "GET|POST|DELETE", "GET|POST|DELETE"},
+    {"alt_words", "alice|bob|carol|dave|erin|frank", "alice|bob|carol|dave|erin|frank"},
+    {"digits", "id=\\d\\d*", "id=[0-9][0-9]*"},
+    {"date", "\\d\\d\\d\\d-\\d\\d-\\d\\d", "[0-9][0-9][0-9][0-9]-[0-9][0-9]-[0-9][0-9]"},
+    {"ipv4", "\\d\\d*\\.\\d\\d*\\.\\d\\d*\\.\\d\\d*",
+        "[0-9][0-9]*\\.[0-9][0-9]*\\.[0-9][0-9]*\\.[0-9][0-9]*"},
+    {"email", "\\w\\w*@\\w\\w*\\.\\w\\w*",
+        "[0-9A-Za-z_][0-9A-Za-z_]*@[0-9A-Za-z_][0-9A-Za-z_]*\\.[0-9A-Za-z_][0-9A-Za-z_]*"},
+    {"space_word", "\\s\\w\\w*ms", "[\t\n\v\f\r ][0-9A-Za-z_][0-9A-Za-z_]*ms"},
+    {"closure", "(\\w|\\s)*timeout", "([0-9A-Za-z_]|[\t\n\v\f\r ])*timeout"},
+    {"dot_star", "user=.*@example", "user=.*@example"},
+    {"utf8", "(é|ü|ж)\\w\\w*", "(é|ü|ж)[0-9A-Za-z_][0-9A-Za-z_]*"},
+};
+
+/*  '.' on UTF-8 cut short or whole, the length of the
+ *  longest match   */
+struct utf8_check{
+    const char *pattern;
+    const char *input;
+    int length;
+};
+
+static const struct utf8_check utf8_checks[] = {
+    {".", "\xc3", 1},
+    {".x", "\xe6\x97" "x", 3},
+    {".*", "\xf0\x9f\x98", 3},
+    {".|\\S", "\xc3\xa9", 2},
+    {"\\S|a.", "\xc3\xa9", 1},
+    {"\\W\\W|.", "\xe2\x82\xac", 3},
+};
+
+/*  Lines of a corpus, line i is text[offset[i]] ...
+ *  text[offset[i+1]-2], '\n' or '\0' after each   */
+struct corpus{
+    const char *name;
+    char *text;
+    char *lines;
+    uint32_t *offset;
+    size_t bytes;
+    size_t count;
+};
+
+static unsigned int seed = 1;
+
+static unsigned int next(void){
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static const char *pick(const char *const words[], int n){
+    return words[next() % n];
+}
+
+static const char *const users[] = {"alice", "bob", "carol", "dave", "erin", "frank", "grace", "heidi"};
+static const char *const hosts[] = {"example", "mail", "corp", "uni", "news"};
+
+static int log_line(char *c){
+    static const char *const levels[] = {"INFO", "INFO", "INFO", "WARN", "ERROR", "DEBUG"};
+    static const char *const methods[] = {"GET", "GET", "POST", "PUT", "DELETE"};
+    static const char *const notes[] = {"", "", "", " timeout", " retry", " deadlock"};
+    unsigned int r = next();
+    return sprintf(c, "2015-%02u-%02u %02u:%02u:%02u %s [worker-%u] %s /api/v1/items/%u"
+            " from 10.%u.%u.%u %ums user=%s@%s.com id=%u%s\n",
+            r%12 + 1, r%28 + 1, r%24, r%60, next()%60, pick(levels, 6), r%16, pick(methods, 5),
+            next()%100000, r%256, next()%256, r%256, next()%2000,
+            pick(users, 8), pick(hosts, 5), next(), pick(notes, 6));
+}
+
+static int email_line(char *c){
+    static const char *const words[] = {"Re:", "meeting", "notes", "for", "the", "report", "on", "Friday"};
+    unsigned int r = next();
+    if(r%3)
+        return sprintf(c, "From: %s %s <%s.%u@%s.org>\n", pick(users, 8), pick(users, 8),
+                pick(users, 8), r%1000, pick(hosts, 5));
+    return sprintf(c, "Subject: %s %s %s %s\n", pick(words, 8), pick(words, 8), pick(words, 8), pick(words, 8));
+}
+
+static int utf8_line(char *c){
+    static const char *const words[] = {"café", "naïve", "über", "straße", "жизнь", "мир",
+        "日本語", "テキスト", "😀", "plain", "text", "42", "über9", "émigré"};
+    int len = 0;
+    for(int n = next()%12 + 3; n--; )
+        len += sprintf(c + len, "%s%s", pick(words, 14), n? " ": "\n");
+    return len;
+}
+
+static int make_corpus(struct corpus *corpus, const char *name, int (*line)(char *), size_t bytes){
+    corpus->name = name;
+    corpus->text = malloc(bytes + 512);
+    corpus->lines = malloc(bytes + 512);
+    corpus->offset = malloc(sizeof(uint32_t) * (bytes/8 + 2));
+    if(!corpus->text || !corpus->lines || !corpus->offset)return 0;
+    size_t len = 0, count = 0;
+    while(len < bytes){
+        corpus->offset[count++] = len;
+        len += line(corpus->text + len);
+    }
+    corpus->offset[count] = len;
+    corpus->bytes = len;
+    corpus->count = count;
+    /*  a '\0' ended copy for regexec()   */
+    memcpy(corpus->lines, corpus->text, len);
+    for(size_t i = 0; i<count; i++)
+        corpus->lines[corpus->offset[i+1] - 1] = '\0';
+    return 1;
+}
+
+static long long now_ns(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+/*  Hardware counters of the best round, -1 if not counted  */
+struct counters{
+    int fd[2];
+    long long value[2];
+};
+
+static void counters_open(struct counters *counters, int enable){
+    counters->fd[0] = counters->fd[1] = -1;
+#ifdef __linux__
+    static const unsigned long long config[2] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_BRANCH_MISSES};
+    for(int i = 0; enable && i<2; i++){
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = config[i];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        counters->fd[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#else
+    (void)enable;
+#endif
+}
+
+static void counters_start(struct counters *counters){
+#ifdef __linux__
+    for(int i = 0; i<2; i++)
+        if(counters->fd[i] >= 0){
+            ioctl(counters->fd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(counters->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+#else
+    (void)counters;
+#endif
+}
+
+static void counters_stop(struct counters *counters, long long value[2]){
+    for(int i = 0; i<2; i++){
+        value[i] = -1;
+#ifdef __linux__
+        if(counters->fd[i] < 0)continue;
+        ioctl(counters->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        if(read(counters->fd[i], value + i, sizeof(long long)) != sizeof(long long))value[i] = -1;
+#endif
+    }
+}
+
+static void counters_close(struct counters *counters){
+    for(int i = 0; i<2; i++)
+        if(counters->fd[i] >= 0)close(counters->fd[i]);
+}
+
+enum engine{VM, TABLE, BATCH, JIT, POSIX, ENGINES};
+static const char *const engine_name[] = {"vm", "table", "batch", "jit", "posix"};
+
+/*  Programs of a pattern, program[VM] and program[TABLE],
+ *  program[BATCH] and jit of ".*(pattern)"   */
+struct compiled{
+    int *program[ENGINES];
+    struct limregex_jit *jit;
+    regex_t posix;
+    int posix_ok;
+};
+
+/*  Compile a pattern for an engine once.
+ *  @return int 1 compiled, 0 failed
+ */
+static int compile(enum engine engine, const struct pattern *pattern, struct compiled *compiled){
+    char anywhere[PATTERN_MAX];
+    snprintf(anywhere, sizeof(anywhere), ".*(%s)", pattern->limregex);
+    switch(engine){
+        case VM:
+            return limregexcl(compiled->program[VM], PROGRAM_MAX, anywhere) > 0;
+        case TABLE:
+            return limregex_compile_table(compiled->program[TABLE], PROGRAM_MAX, pattern->limregex) > 0;
+        case BATCH:
+            return limregex_compile_table(compiled->program[BATCH], PROGRAM_MAX, anywhere) > 0;
+        case JIT:
+            limregex_jit_free(compiled->jit);
+            compiled->jit = limregex_jit_compile(anywhere);
+            return compiled->jit != NULL;
+        case POSIX:
+            if(compiled->posix_ok)regfree(&compiled->posix);
+            compiled->posix_ok = regcomp(&compiled->posix, pattern->posix, REG_EXTENDED | REG_NOSUB) == 0;
+            return compiled->posix_ok;
+        default:
+            return 0;
+    }
+}
+
+/*  Count the matched lines of a corpus once    */
+static size_t run(enum engine engine, const struct compiled *compiled, const struct corpus *corpus, unsigned char *bitmap){
+    size_t matches = 0;
+    int start;
+    for(size_t i = 0; engine != BATCH && i<corpus->count; i++){
+        const char *line = corpus->text + corpus->offset[i];
+        size_t len = corpus->offset[i+1] - corpus->offset[i] - 1;
+        switch(engine){
+            case VM:
+                matches += limregexec_mode_n(line, len, compiled->program[VM], LIMREGEX_IS_MATCH) > 0;
+                break;
+            case TABLE:
+                matches += limregex_search_n(line, len, compiled->program[TABLE], &start) > 0;
+                break;
+            case JIT:
+                matches += limregex_jit_exec_mode_n(line, len, compiled->jit, LIMREGEX_IS_MATCH) > 0;
+                break;
+            case POSIX:
+                matches += regexec(&compiled->posix, corpus->lines + corpus->offset[i], 0, NULL, 0) == 0;
+                break;
+            default:
+                break;
+        }
+    }
+    if(engine == BATCH)
+        matches = limregex_exec_batch(corpus->text, corpus->offset, corpus->count,
+                compiled->program[BATCH], bitmap, NULL);
+    return matches;
+}
+
+/*  Match the UTF-8 checks by every limregex engine, and
+ *  in LIMREGEX_FULL mode by the ones taking modes, a
+ *  length other than the expected one is reported.
+ *  @return int Number of failed checks
+ */
+static int check_utf8(int *program){
+    static const char *const name[] = {"vm", "table", "lazy", "capture", "jit"};
+    int failed = 0;
+    for(size_t i = 0; i<sizeof(utf8_checks)/sizeof(utf8_checks[0]); i++){
+        const struct utf8_check *check = utf8_checks + i;
+        size_t len = strlen(check->input);
+        int length[5] = {-1, -1, -1, -1, -1};
+        int full[5] = {-1, -1, -1, -1, -1};
+        int spans[2];
+        if(limregexcl(program, PROGRAM_MAX, check->pattern) > 0){
+            length[0] = limregexec_mode_n(check->input, len, program, LIMREGEX_LONGEST);
+            full[0] = limregexec_mode_n(check->input, len, program, LIMREGEX_FULL);
+        }
+        if(limregex_compile_table(program, PROGRAM_MAX, check->pattern) > 0){
+            length[1] = limregex_exec_table_n(check->input, len, program);
+            full[1] = limregex_exec_table_mode_n(check->input, len, program, LIMREGEX_FULL);
+        }
+        struct limregex_lazy *lazy = limregex_lazy_compile(check->pattern, 1<<16);
+        if(lazy)length[2] = limregex_lazy_exec_n(check->input, len, lazy);
+        limregex_lazy_free(lazy);
+        struct limregex_capture *cap = limregex_capture_compile(check->pattern);
+        if(cap)length[3] = limregex_capture_exec_n(check->input, len, cap, spans);
+        limregex_capture_free(cap);
+        struct limregex_jit *jit = limregex_jit_compile(check->pattern);
+        if(jit){
+            length[4] = limregex_jit_exec_mode_n(check->input, len, jit, LIMREGEX_LONGEST);
+            full[4] = limregex_jit_exec_mode_n(check->input, len, jit, LIMREGEX_FULL);
+        }
+        limregex_jit_free(jit);
+        /*  lazy and capture take no mode   */
+        full[2] = full[3] = (check->length == (int)len)? check->length: 0;
+        for(int engine = 0; engine<5; engine++){
+            if(length[engine] != check->length){
+                fprintf(stderr, "utf8 check %zu \"%s\": %s %d, expected %d\n", i, check->pattern,
+                        name[engine], length[engine], check->length);
+                failed++;
+            }
+            if(full[engine] != full[2]){
+                fprintf(stderr, "utf8 check %zu \"%s\": %s full %d, expected %d\n", i, check->pattern,
+                        name[engine], full[engine], full[2]);
+                failed++;
+            }
+        }
+    }
+    return failed;
+}
+
+static void field(long long value){
+    if(value < 0)printf("\t-");
+    else printf("\t%lld", value);
+}
+
+static void bench(const struct pattern *pattern, const struct corpus *corpus, struct compiled *compiled,
+        struct counters *counters, int rounds, unsigned char *bitmap){
+    long long expect = -1;
+    int first = 0;
+    for(int engine = 0; engine<ENGINES; engine++){
+        /*  time of a compile, over enough compiles */
+        long long compiles = 0, t = now_ns(), compile_ns;
+        int ok;
+        do{
+            ok = compile(engine, pattern, compiled);
+            compiles++;
+        }while(ok && now_ns() - t < COMPILE_NS);
+        compile_ns = (now_ns() - t) / compiles;
+        printf("%s\t%s\t%s", corpus->name, pattern->name, engine_name[engine]);
+        if(!ok){
+            printf("\t-\t%zu\t-\t-\t-\t-\t-\t-\n", corpus->bytes);
+            continue;
+        }
+        long long best = -1, value[2] = {-1, -1};
+        size_t matches = 0;
+        for(int r = 0; r<rounds; r++){
+            long long round[2];
+            counters_start(counters);
+            t = now_ns();
+            matches = run(engine, compiled, corpus, bitmap);
+            t = now_ns() - t;
+            counters_stop(counters, round);
+            if(best < 0 || t < best){
+                best = t;
+                value[0] = round[0];
+                value[1] = round[1];
+            }
+        }
+        if(expect < 0){
+            expect = matches;
+            first = engine;
+        }
+        else if((long long)matches != expect)
+            fprintf(stderr, "%s %s: %s %zu matches, %s %lld\n", corpus->name, pattern->name,
+                    engine_name[engine], matches, engine_name[first], expect);
+        printf("\t%lld\t%zu\t%zu\t%lld\t%.1f", compile_ns, corpus->bytes, matches, best,
+                corpus->bytes * 1e3 / (best? best: 1));
+        if(matches)printf("\t%.1f", (double)best / matches);
+        else printf("\t-");
+        field(value[0]);
+        field(value[1]);
+        printf("\n");
+        fflush(stdout);
+    }
+}
+
+int main(int argc, char *argv[]){
+    size_t bytes = CORPUS_BYTES;
+    int rounds = ROUNDS, perf = 0, opt;
+    while((opt = getopt(argc, argv, "b:r:s:p")) != -1){
+        switch(opt){
+            case 'b': bytes = strtoul(optarg, NULL, 0); break;
+            case 'r': rounds = atoi(optarg); break;
+            case 's': seed = strtoul(optarg, NULL, 0); break;
+            case 'p': perf = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-b corpus bytes] [-r rounds] [-s seed] [-p]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if(bytes < 1024)bytes = 1024;
+    if(bytes > (1u<<30))bytes = 1u<<30;
+    if(rounds < 1)rounds = 1;
+    struct corpus corpora[3];
+    if(!make_corpus(corpora, "log", log_line, bytes)
+            || !make_corpus(corpora + 1, "email", email_line, bytes)
+            || !make_corpus(corpora + 2, "utf8", utf8_line, bytes)){
+        fprintf(stderr, "no memory\n");
+        return EXIT_FAILURE;
+    }
+    struct compiled compiled = {.jit = NULL, .posix_ok = 0};
+    for(int engine = 0; engine<JIT; engine++)
+        compiled.program[engine] = malloc(sizeof(int) * PROGRAM_MAX);
+    unsigned char *bitmap = malloc(bytes/8 + 1);
+    if(!compiled.program[VM] || !compiled.program[TABLE] || !compiled.program[BATCH] || !bitmap){
+        fprintf(stderr, "no memory\n");
+        return EXIT_FAILURE;
+    }
+    check_utf8(compiled.program[VM]);
+    struct counters counters;
+    counters_open(&counters, perf);
+    printf("corpus\tpattern\tengine\tcompile_ns\tbytes\tmatches\tns\tMB/s\tns/match\tcycles\tbranch_misses\n");
+    for(size_t p = 0; p<sizeof(catalogue)/sizeof(catalogue[0]); p++)
+        for(int c = 0; c<3; c++)
+            bench(catalogue + p, corpora + c, &compiled, &counters, rounds, bitmap);
+    counters_close(&counters);
+    if(compiled.posix_ok)regfree(&compiled.posix);
+    limregex_jit_free(compiled.jit);
+    for(int engine = 0; engine<JIT; engine++)
+        free(compiled.program[engine]);
+    for(int c = 0; c<3; c++){
+        free(corpora[c].text);
+        free(corpora[c].lines);
+        free(corpora[c].offset);
+    }
+    free(bitmap);
+    return EXIT_SUCCESS;
+}
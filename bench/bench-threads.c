@@ -0,0 +1,124 @@
+/*
+ * Matching throughput against threads sharing one program.
+ *      cc -std=c99 -O2 -pthread -I.. -o bench-threads bench-threads.c ../limregex.c
+ *      ./bench-threads [max threads]
+ * One table and one VM program are compiled once and read
+ * by every thread, each thread scans the whole text a few
+ * times. Throughput grows linearly with the threads when
+ * matching takes no lock and writes no shared state, up to
+ * the number of cores.
+ *
+ * Copyright (C) 2015 ZHANG X. <201560039.uibe.edu.cn>
+ * Released under the MIT licence, see limregex.c.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "limregex.h"
+
+#define TEXT_LEN (1<<22)
+#define ROUNDS 4
+#define THREADS_MAX 256
+
+static const char pattern[] = "ERROR\\s\\w*: \\d\\d*ms";
+
+static char text[TEXT_LEN];
+static const int *table;
+static const int *program;
+
+struct job{
+    pthread_t thread;
+    long long matches;
+};
+
+static double now(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/*  log-like lines, some of them match    */
+static void make_text(void){
+    static const char *words[] = {"INFO", "WARN", "ERROR", "disk", "net", "user", "cache", "é"};
+    unsigned int seed = 1;
+    char *c = text;
+    while(c < text + TEXT_LEN - 64){
+        seed = seed * 1103515245 + 12345;
+        c += sprintf(c, "%s %s: %ums id=%u\n", words[seed>>16 & 3],
+                words[4 + (seed>>20 & 3)], seed>>8 & 1023, seed>>4 & 0xffff);
+    }
+    memset(c, '\n', text + TEXT_LEN - c);
+}
+
+/*  table search over the text, then the VM at each line  */
+static void *scan(void *arg){
+    struct job *job = arg;
+    long long matches = 0;
+    for(int r = 0; r<ROUNDS; r++){
+        size_t pos = 0;
+        int start, len;
+        while(pos < TEXT_LEN
+                && (len = limregex_search_n(text + pos, TEXT_LEN - pos, table, &start)) > 0){
+            matches++;
+            pos += start + len;
+        }
+        for(const char *line = text; line; ){
+            const char *next = memchr(line, '\n', text + TEXT_LEN - line);
+            if(next && limregexec_n(line, next - line, program) > 0)matches++;
+            line = next? next + 1: NULL;
+        }
+    }
+    job->matches = matches;
+    return NULL;
+}
+
+static int compile(const char *regexp, int kind, const int **out){
+    struct limregex_context *context = limregex_context_new(NULL);
+    int len = context? limregex_context_compile(context, regexp, strlen(regexp), kind): -1;
+    int *buf = (len > 0)? malloc(len * sizeof(int)): NULL;
+    if(buf)limregex_context_emit(context, buf, len);
+    limregex_context_free(context);
+    *out = buf;
+    return buf != NULL;
+}
+
+int main(int argc, char *argv[]){
+    static struct job jobs[THREADS_MAX];
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int maxThreads = (argc > 1)? atoi(argv[1]): (cores > 0)? (int)cores: 1;
+    if(maxThreads < 1 || maxThreads > THREADS_MAX)maxThreads = THREADS_MAX;
+    make_text();
+    if(!compile(pattern, LIMREGEX_TABLE, &table) || !compile(pattern, LIMREGEX_VM, &program)){
+        fprintf(stderr, "compile failed\n");
+        return EXIT_FAILURE;
+    }
+    printf("%8s %12s %12s %10s %10s\n", "threads", "ms", "MB/s", "speedup", "matches");
+    double single = 0;
+    long long expect = -1;
+    for(int n = 1; n <= maxThreads; n = (n*2 > maxThreads && n < maxThreads)? maxThreads: n*2){
+        double t = now();
+        for(int i = 0; i<n; i++)
+            pthread_create(&jobs[i].thread, NULL, scan, jobs + i);
+        for(int i = 0; i<n; i++)
+            pthread_join(jobs[i].thread, NULL);
+        t = now() - t;
+        /*  every thread sees the same program    */
+        if(expect < 0)expect = jobs[0].matches;
+        for(int i = 0; i<n; i++)
+            if(jobs[i].matches != expect){
+                fprintf(stderr, "thread %d: %lld matches, %lld expected\n", i, jobs[i].matches, expect);
+                return EXIT_FAILURE;
+            }
+        double rate = (double)n * TEXT_LEN * ROUNDS / t;
+        if(n == 1)single = rate;
+        printf("%8d %12.3f %12.1f %10.2f %10lld\n", n, t * 1e3, rate / 1e6, rate / single, expect);
+    }
+    free((void *)table);
+    free((void *)program);
+    return EXIT_SUCCESS;
+}
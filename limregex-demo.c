@@ -3,35 +3,196 @@
  * Released under the MIT licence, see bottom of file.
  */
 
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "limregex.h"
 
 char re0[]  =   "hs|(s|hh)s*h";
 char str0[] =   "sssssh";
 int match_len;
-int mem_len;
 int code_len;
 int *regexp_code;
 
+/*  Scan mode:
+ *  -g  print matching lines
+ *  -o  print every match in matching lines
+ *  -c  print the summary only
+ *  -p  print where the first match in a file ends,
+ *      a file is searched by a thread a CPU  */
+char scan_mode;
+/*  more than one file, print file names   */
+int scan_names;
+long long scan_bytes;
+long long scan_lines;
+long long scan_matches;
+
+static double now(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/*  Report matches in a line.   */
+static void scan_line(const char *name, const char *buf,
+        const char *line, const char *eol, const int *table){
+    int start;
+    int len;
+    if(scan_mode != 'o'){
+        scan_matches++;
+        if(scan_mode == 'c')return;
+        if(scan_names)printf("%s:", name);
+        fwrite(line, 1, eol - line, stdout);
+        putchar('\n');
+        return;
+    }
+    /*  leftmost longest matches, not overlapping  */
+    for(const char *c = line; c < eol; c += start + len){
+        if((len = limregex_search_n(c, eol - c, table, &start)) <= 0)
+            break;
+        scan_matches++;
+        if(scan_names)printf("%s:", name);
+        printf("%lld:", (long long)(c + start - buf));
+        fwrite(c + start, 1, len, stdout);
+        putchar('\n');
+    }
+}
+
+/*  Search a buffer line by line.
+ *  The stream search finds where the first match ends at
+ *  full speed, then only that line is searched alone, as
+ *  a match of the stream may span lines.
+ */
+static void scan_buffer(const char *name, const char *buf, size_t size, const int *table){
+    const char *end = buf + size;
+    const char *c = buf;
+    struct limregex_stream stream;
+    for(const char *l = buf; l < end && (l = memchr(l, '\n', end - l)); l++)
+        scan_lines++;
+    if(size && end[-1] != '\n')
+        scan_lines++;
+    /*  a match may be empty, then every line has one,
+     *  the stream and limregex_search_n() find none   */
+    if(limregex_exec_table_mode_n("", 0, table, LIMREGEX_IS_MATCH) > 0){
+        for(const char *eol; c < end; c = eol + 1){
+            if(!(eol = memchr(c, '\n', end - c)))eol = end;
+            scan_line(name, buf, c, eol, table);
+        }
+        scan_bytes += size;
+        return;
+    }
+    while(c < end){
+        limregex_stream_init(&stream, table);
+        limregex_stream_feed(&stream, c, end - c);
+        long long match_end = limregex_stream_end(&stream);
+        if(match_end < 0)break;
+        /*  the line the match ends in  */
+        const char *last = c + (match_end? match_end - 1: 0);
+        const char *line = last;
+        while(line > c && line[-1] != '\n')line--;
+        const char *eol = memchr(last, '\n', end - last);
+        if(!eol)eol = end;
+        int start;
+        if(limregex_search_n(line, eol - line, table, &start) > 0)
+            scan_line(name, buf, line, eol, table);
+        c = eol + 1;
+    }
+    scan_bytes += size;
+}
+
+/*  mmap() a file and scan it.
+ *  @return int 0, or <0 for an unreadable file.
+ */
+static int scan_file(const char *name, const int *table){
+    struct stat st;
+    int fd = open(name, O_RDONLY);
+    if(fd < 0 || fstat(fd, &st) < 0){
+        perror(name);
+        if(fd >= 0)close(fd);
+        return(-1);
+    }
+    if(st.st_size > 0){
+        char *buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(buf == MAP_FAILED){
+            perror(name);
+            close(fd);
+            return(-1);
+        }
+        posix_madvise(buf, st.st_size, POSIX_MADV_SEQUENTIAL);
+        if(scan_mode == 'p'){
+            long long match_end = limregex_search_parallel(buf, st.st_size, table,
+                    sysconf(_SC_NPROCESSORS_ONLN));
+            if(match_end >= 0){
+                scan_matches++;
+                printf("%s:%lld\n", name, match_end);
+            }
+            scan_bytes += st.st_size;
+        }else
+            scan_buffer(name, buf, st.st_size, table);
+        munmap(buf, st.st_size);
+    }
+    close(fd);
+    return 0;
+}
+
+/*  Compile to a buffer of the exact size, the
+ *  context tells the size first.  */
+static int *compile(const char regexp[], int kind, int *len){
+    struct limregex_context *context = limregex_context_new(NULL);
+    int *code = NULL;
+    *len = context? limregex_context_compile(context, regexp, strlen(regexp), kind): -1;
+    if(*len > 0 && (code = malloc(*len * sizeof(int))))
+        limregex_context_emit(context, code, *len);
+    limregex_context_free(context);
+    return code;
+}
+
+/*  limregex-demo -g|-o|-c|-p regexp file...   */
+static int scan(int argc, char *argv[]){
+    int status = EXIT_SUCCESS;
+    scan_mode = argv[1][1];
+    scan_names = argc > 4;
+    double t = now();
+    int *table = compile(argv[2], LIMREGEX_TABLE, &code_len);
+    double compile_time = now() - t;
+    if(!table){
+        fprintf(stderr, "Can't compile \"%s\".\n", argv[2]);
+        free(table);
+        return EXIT_FAILURE;
+    }
+    t = now();
+    for(int n = 3; n<argc; n++)
+        if(scan_file(argv[n], table) < 0)status = EXIT_FAILURE;
+    t = now() - t;
+    fflush(stdout);
+    fprintf(stderr, "bytes: %lld\n"
+            "lines: %lld\n"
+            "matches: %lld\n"
+            "scan: %.6f s, %.3f GB/s\n"
+            "compile: %.6f s, %d states, %d int\n",
+            scan_bytes, scan_lines, scan_matches,
+            t, (t > 0)? scan_bytes / t / 1e9: 0,
+            compile_time, table[0], code_len);
+    free(table);
+    return status;
+}
+
 int main(int argc, char *argv[]){
+    if(argc>3 && argv[1][0] == '-' && strchr("gocp", argv[1][1])
+            && argv[1][1] && !argv[1][2])
+        return scan(argc, argv);
     if(argc>1){
-        mem_len = strlen(argv[1]) * 10;
-        code_len = 0;
-        regexp_code = malloc((size_t)(mem_len * sizeof(int)));
-        if(regexp_code){
-            /*  compile */
-            while((code_len = limregexcl(regexp_code, mem_len, argv[1]))<0){
-                mem_len *= 2;
-                int *new_re_code
-                    = realloc(regexp_code,
-                            mem_len * sizeof(int));
-                if(new_re_code != regexp_code){
-                    free(regexp_code);
-                    regexp_code = new_re_code;
-                }
-            }
+        /*  compile */
+        regexp_code = compile(argv[1], LIMREGEX_VM, &code_len);
+        if(!regexp_code){
+            fprintf(stderr, "Can't compile \"%s\".\n", argv[1]);
+            return EXIT_FAILURE;
         }
         printf("{");
         for(int n=0; n<code_len; n++)
@@ -43,6 +204,7 @@ int main(int argc, char *argv[]){
         printf("}\n");
     }else{
         printf("Usage: limregex-demo regexp string\n"
+                "       limregex-demo -g|-o|-c|-p regexp file...\n"
                 "Regular expression: %s\n"
                 "String: %s\n", re0, str0);
 
@@ -2,12 +2,11 @@
  * limregex
  * --- A DFA-based regular expression
  *      prototype implementation,
- *      WITHOUT submatch extraction.
+ *      submatches by a tagged NFA.
  *
  * Supports only * | ( ) ? . \d \D \w \W \s \S.
  * Support backslash"\" and "\xHH" escapes.
- * Support UTF-8 and could be configured
- *  to support other encodings.
+ * Support UTF-8, independent of the locale.
  * NO support for + ,
  *      + and \+ both will match character '+'.
  * NO support for character classes,
@@ -20,13 +19,29 @@
  * Released under the MIT licence, see bottom of file.
  */
 
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
 #include <stdlib.h>
 #include <string.h>
-#include <locale.h>
 #include <limits.h>
-#include <ctype.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include "limregex.h"
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define RUN_SIMD
+#endif
+
+/*  Native code of DFAs, VM instructions elsewhere  */
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__) && !defined(LIMREGEX_NO_JIT)
+#include <sys/mman.h>
+#define JIT_X86_64
+#endif
+
 /*  Fixed final(accept) state for NFA.
  *  initial_state 1                 */
 #define FINAL_STATE 0
@@ -35,15 +50,56 @@
  *  are all greater than characters.    */
 #define OP_MIN 0x8000
 
+/*  Fewest bytes limregex_search_parallel() gives
+ *  a thread.  */
+#define PARALLEL_CHUNK (1<<16)
+
+/*  Header of limregex_save() saved programs, magic
+ *  is "LREX" in a little-endian file, the layout
+ *  version changes when VM or table layout changes.  */
+#define SAVE_MAGIC 0x5845524cu
+#define SAVE_ORDER 0x01020304u
+#define SAVE_VERSION 3
+
+/*  Results of the steps building a DFA, for no room in
+ *  arrays which then grow, and for no memory.  */
+#define NO_SPACE (-1)
+#define NO_MEMORY (-3)
+
+/*  Alignment of arena pieces, and the smallest block   */
+#define ARENA_ALIGN 16
+#define ARENA_BLOCK_MIN (64u<<10)
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN-1) & ~(size_t)(ARENA_ALIGN-1))
+#define ARENA_DATA(block) ((char *)(block) + ARENA_ROUND(sizeof(struct arenaBlock)))
+
+/*  States and elements of struct limregex_lazy    */
+#define LAZY_UNKNOWN (-1)
+#define LAZY_DEAD 0
+#define LAZY_START 1
+#define LAZY_SEARCH_START 2
+#define LAZY_UTF8(len, a, k) ((a) + (k)*(len))
+#define LAZY_SEARCH(len) (4*(len))
+/*  Smallest cache of a lazy DFA, in states */
+#define LAZY_STATES_MIN 8
+
+/*  Compiled program cache, shards of their own lock
+ *  and LRU list, the budget is split among the shards.  */
+#define CACHE_SHARDS 16
+#define CACHE_BUDGET (64u<<20)
+#define CACHE_BUCKETS 64
+/*  Most memory of a compile for the cache, in int  */
+#define CACHE_PROGRAM_MAX (1<<26)
+
+/*  PATTERN_TAG+n in postfix RegExp ends pattern n of a
+ *  set, it is greater than all operators.  */
+#define PATTERN_TAG 0x10000
+
 /*  Mark input characters in a FA transition.
  *  METACHAR:       transition for character range
  *  EPSILON:        Epsilon-move
- *  EXTRACT_FLAG:   not a transition but descript
- *                  submatch-extraction range
  */ 
 enum deltaInputFlag {
     METACHAR = ESCAPE_CHAR<<8,
-    EXTRACT_FLAG = (ESCAPE_CHAR+1)<<8,
     EPSILON = (ESCAPE_CHAR+2)<<8
 };
 
@@ -60,7 +116,14 @@ enum regexpOperator {
 
 enum subsetState{ACTIVE = 0, COMPLETE = 1, FINAL = 2};
 
-/*  Transition Function */
+/*  Words of a bitmap of n patterns    */
+#define SET_WORDS(n) (((n)+31)/32)
+
+/*  Transition Function
+ *  nparen: Of an Epsilon-move, n+1 if it ends pattern n
+ *          of a set, or -GROUP_OPEN(g), -GROUP_CLOSE(g)
+ *          if it enters or leaves group g, 0 for neither
+ */
 struct FAdelta{
     int before;
     int input;
@@ -68,6 +131,116 @@ struct FAdelta{
     int nparen;
 };
 
+/*  Capture slots of group g, 1 for the leftmost '(',
+ *  slots 0 and 1 hold the whole match.  */
+#define GROUP_OPEN(g) (2*(g))
+#define GROUP_CLOSE(g) (2*(g)+1)
+
+/*  Run kernel of a table row: a row staying on at least
+ *  KERNEL_MIN bytes, which are at most KERNEL_RANGES
+ *  ranges, skips them by regexpRun().
+ *  A kernel is KERNEL_SIZE bytes: number of ranges,
+ *  then first and last byte of each range.
+ */
+#define KERNEL_MIN 10
+#define KERNEL_RANGES 7
+#define KERNEL_SIZE 16
+#define KERNEL_MAX 8
+
+/*  Reverse rows of a table are made if there are at most
+ *  REVERSE_ROWS_MIN more than twice the rows before them  */
+#define REVERSE_ROWS_MIN 64
+
+/*  Max length of literal strings found by regexpLiteral()  */
+#define LITERAL_MAX 32
+
+/*  Literal strings of a sub-expression.
+ *  exact:  The only string it matches, if exactLen >= 0
+ *  prefix: Every match begins with
+ *  suffix: Every match ends with
+ *  factor: Every match contains
+ */
+struct FAliteral{
+    int exactLen;
+    int prefixLen;
+    int suffixLen;
+    int factorLen;
+    unsigned char exact[LITERAL_MAX];
+    unsigned char prefix[LITERAL_MAX];
+    unsigned char suffix[LITERAL_MAX];
+    unsigned char factor[LITERAL_MAX];
+};
+
+/*  Memory of a compile. Blocks come from the allocator
+ *  and are kept, every piece is taken from the newest
+ *  block and the newest piece can be given back or grown
+ *  in place, the rest goes back at once by arenaReset().
+ *  A NULL arena is the C heap.
+ *  block:      Newest block, linked to the older ones
+ *  allocator:  Hook for the blocks
+ */
+struct arenaBlock{
+    struct arenaBlock *next;
+    size_t size;
+    size_t used;
+};
+
+struct regexpArena{
+    struct arenaBlock *block;
+    struct limregex_allocator allocator;
+};
+
+/*  Header of each piece of an arena, ARENA_ALIGN bytes:
+ *  its size and the used bytes of the block before it   */
+struct arenaHead{
+    size_t size;
+    size_t prev;
+};
+
+/*  NFA of a RegExp or a set, built by regexpNfa().
+ *  deltas: NFA moves
+ *  ref:    Pointers to deltas[] sorted by sortNfa()
+ *  index:  Moves of state l are index[l] ... index[l+1]-1
+ *  len:    Number of states
+ *  groups: Number of groups, their moves are tagged
+ *  lit:    Literal strings of the RegExp
+ */
+struct FAnfa{
+    struct FAdelta *deltas;
+    struct FAdelta **ref;
+    struct FAdelta ***index;
+    int len;
+    int groups;
+    struct FAliteral lit;
+};
+
+/*  DFA handed to a backend by regexpCompile().
+ *  arena:      Memory of the compile, backends take
+ *              theirs from it
+ *  index:      Moves of state l are index[l] ... index[l+1]-1
+ *  len:        Number of states
+ *  labelState: FINAL for accepting states
+ *  subsets:    Number of states before regexpDfaMin()
+ *  lit:        Literal strings of the RegExp
+ *  patterns:   Number of patterns, 0 for a single RegExp
+ *  acceptSet:  Bitmap of patterns each state accepts,
+ *              SET_WORDS(patterns) words a state
+ */
+struct FAdfa{
+    struct regexpArena *arena;
+    struct FAdelta ***index;
+    int len;
+    int subsets;
+    int *labelState;
+    struct FAliteral lit;
+    int patterns;
+    unsigned int *acceptSet;
+};
+
+/*  Offset of the initial state in VM instructions, after
+ *  JMP, its address, ACCEPT and the FAIL before a state */
+#define VM_INIT 4
+
 enum regexpVMcode{
     JMP = 'A',
     JDEG,
@@ -82,93 +255,246 @@ enum regexpVMcode{
     FRWRD,
     FAIL,
     ACCEPT,
-    ACCEPTM1
+    ACCEPTM1,
+    JUTF8
+};
+
+/*  Header of limregex_compile_table() compiled table.
+ *  TBL_ROWS:           Number of rows
+ *  TBL_START:          Offset of the initial state row
+ *  TBL_ACCEPT:         Offset of the first accepting row
+ *  TBL_CLASSES:        Row width, column 0 for the run
+ *                      kernel and a column per byte class
+ *  TBL_SEARCH_START:   Offset of the initial search row
+ *  TBL_SEARCH_ACCEPT:  Offset of the first accepting
+ *                      search row
+ *  TBL_PREFIX_LEN:     Length of the literal every match
+ *                      begins with
+ *  TBL_FACTOR_LEN:     Length of the literal every match
+ *                      contains, 0 if prefix is enough
+ *  TBL_PATTERNS:       Number of patterns of a set,
+ *                      0 for a single RegExp
+ *  TBL_PATTERN_SET:    Offset of an int per row, the offset
+ *                      of the bitmap of patterns the row
+ *                      accepts, 0 if it does not accept
+ *  TBL_REVERSE_START:  Offset of the reverse row of the
+ *                      accepting rows, 0 for no reverse rows
+ *  TBL_REVERSE_LIVE:   Offset of the reverse row of all the
+ *                      rows but the dead one
+ *  TBL_REVERSE_ACCEPT: Offset of the first accepting
+ *                      reverse row
+ *  TBL_FIRSTBYTE:      256 bits, bytes a match begins with
+ *  TBL_LITERAL:        LITERAL_MAX bytes of prefix and
+ *                      LITERAL_MAX bytes of factor
+ *  TBL_KERNEL:         KERNEL_MAX run kernels
+ *  TBL_CLASSMAP:       256 bytes, class of each byte
+ *  TBL_DELTA:          Rows of next states
+ */
+enum regexpTable {
+    TBL_ROWS,
+    TBL_START,
+    TBL_ACCEPT,
+    TBL_CLASSES,
+    TBL_SEARCH_START,
+    TBL_SEARCH_ACCEPT,
+    TBL_PREFIX_LEN,
+    TBL_FACTOR_LEN,
+    TBL_PATTERNS,
+    TBL_PATTERN_SET,
+    TBL_REVERSE_START,
+    TBL_REVERSE_LIVE,
+    TBL_REVERSE_ACCEPT,
+    TBL_FIRSTBYTE,
+    TBL_LITERAL = TBL_FIRSTBYTE + 256/8/sizeof(int),
+    TBL_KERNEL = TBL_LITERAL + LITERAL_MAX*2/sizeof(int),
+    TBL_CLASSMAP = TBL_KERNEL + KERNEL_MAX*KERNEL_SIZE/sizeof(int),
+    TBL_DELTA = TBL_CLASSMAP + 256/sizeof(int)
 };
 
-char ischartype[127] = { 0, ['w'] = 'w', ['W'] = 'W', ['s'] = 's', ['S'] = 'S', ['d'] = 'd', ['D'] = 'D' };
+static const char ischartype[127] = { 0, ['w'] = 'w', ['W'] = 'W', ['s'] = 's', ['S'] = 'S', ['d'] = 'd', ['D'] = 'D' };
 
 /*  \xHH    escape sequences    */
-unsigned short escx1[127] = { 0x100, ['0'] = 0x00, ['1'] = 0x10, ['2'] = 0x20, ['3'] = 0x30, ['4'] = 0x40, ['5'] = 0x50, ['6'] = 0x60, ['7'] = 0x70, ['8'] = 0x80, ['9'] = 0x90, ['A'] = 0xa0, ['B'] = 0xb0, ['C'] = 0xc0, ['D'] = 0xd0, ['E'] = 0xe0, ['F'] = 0xf0, ['a'] = 0xa0, ['b'] = 0xb0, ['c'] = 0xc0, ['d'] = 0xd0, ['e'] = 0xe0, ['f'] = 0xf0 };
+static const unsigned short escx1[127] = { 0x100, ['0'] = 0x00, ['1'] = 0x10, ['2'] = 0x20, ['3'] = 0x30, ['4'] = 0x40, ['5'] = 0x50, ['6'] = 0x60, ['7'] = 0x70, ['8'] = 0x80, ['9'] = 0x90, ['A'] = 0xa0, ['B'] = 0xb0, ['C'] = 0xc0, ['D'] = 0xd0, ['E'] = 0xe0, ['F'] = 0xf0, ['a'] = 0xa0, ['b'] = 0xb0, ['c'] = 0xc0, ['d'] = 0xd0, ['e'] = 0xe0, ['f'] = 0xf0 };
+
+static const unsigned short escx0[127] = { 0x100, ['0'] = 0x0, ['1'] = 0x1, ['2'] = 0x2, ['3'] = 0x3, ['4'] = 0x4, ['5'] = 0x5, ['6'] = 0x6, ['7'] = 0x7, ['8'] = 0x8, ['9'] = 0x9, ['A'] = 0xa, ['B'] = 0xb, ['C'] = 0xc, ['D'] = 0xd, ['E'] = 0xe, ['F'] = 0xf, ['a'] = 0xa, ['b'] = 0xb, ['c'] = 0xc, ['d'] = 0xd, ['e'] = 0xe, ['f'] = 0xf };
+
+/*  Classes of \d, \w and \s as in the "C" locale, so no
+ *  program depends on the locale of a process.  */
+#define CHAR_DIGIT 1
+#define CHAR_WORD 2
+#define CHAR_SPACE 4
+static const unsigned char charClass[256] = { ['\t'] = CHAR_SPACE, ['\n'] = CHAR_SPACE, ['\v'] = CHAR_SPACE, ['\f'] = CHAR_SPACE, ['\r'] = CHAR_SPACE, [' '] = CHAR_SPACE,
+    ['0'] = 3, ['1'] = 3, ['2'] = 3, ['3'] = 3, ['4'] = 3, ['5'] = 3, ['6'] = 3, ['7'] = 3, ['8'] = 3, ['9'] = 3, ['_'] = CHAR_WORD,
+    ['A'] = CHAR_WORD, ['B'] = CHAR_WORD, ['C'] = CHAR_WORD, ['D'] = CHAR_WORD, ['E'] = CHAR_WORD, ['F'] = CHAR_WORD, ['G'] = CHAR_WORD, ['H'] = CHAR_WORD, ['I'] = CHAR_WORD, ['J'] = CHAR_WORD, ['K'] = CHAR_WORD, ['L'] = CHAR_WORD, ['M'] = CHAR_WORD,
+    ['N'] = CHAR_WORD, ['O'] = CHAR_WORD, ['P'] = CHAR_WORD, ['Q'] = CHAR_WORD, ['R'] = CHAR_WORD, ['S'] = CHAR_WORD, ['T'] = CHAR_WORD, ['U'] = CHAR_WORD, ['V'] = CHAR_WORD, ['W'] = CHAR_WORD, ['X'] = CHAR_WORD, ['Y'] = CHAR_WORD, ['Z'] = CHAR_WORD,
+    ['a'] = CHAR_WORD, ['b'] = CHAR_WORD, ['c'] = CHAR_WORD, ['d'] = CHAR_WORD, ['e'] = CHAR_WORD, ['f'] = CHAR_WORD, ['g'] = CHAR_WORD, ['h'] = CHAR_WORD, ['i'] = CHAR_WORD, ['j'] = CHAR_WORD, ['k'] = CHAR_WORD, ['l'] = CHAR_WORD, ['m'] = CHAR_WORD,
+    ['n'] = CHAR_WORD, ['o'] = CHAR_WORD, ['p'] = CHAR_WORD, ['q'] = CHAR_WORD, ['r'] = CHAR_WORD, ['s'] = CHAR_WORD, ['t'] = CHAR_WORD, ['u'] = CHAR_WORD, ['v'] = CHAR_WORD, ['w'] = CHAR_WORD, ['x'] = CHAR_WORD, ['y'] = CHAR_WORD, ['z'] = CHAR_WORD };
+#define IS_CHAR(class, c) (charClass[(unsigned char)(c)] & (class))
+
+/*  Bytes of the UTF-8 character at c[], as '.' takes it
+ *  in every engine: 0xc2-0xdf, 0xe0-0xef and 0xf0-0xf4
+ *  lead 2, 3 and 4 bytes characters, a character cut by
+ *  the end or by a byte not 0x80-0xbf is its lead byte
+ *  and the continuation bytes before the cut, any other
+ *  byte is a character by itself.
+ *  @param  n       Bytes readable at c[]
+ *  @return int     Bytes of the character
+ *                  0   for '\0'
+ */
+static int utf8Width(const char c[], size_t n){
+    const unsigned char lead = (unsigned char)c[0];
+    if(lead < 0x80)return lead != 0;
+    int width = (lead < 0xc2)? 1: (lead < 0xe0)? 2: (lead < 0xf0)? 3: (lead < 0xf5)? 4: 1;
+    int i = 1;
+    while(i < width && (size_t)i < n && ((unsigned char)c[i] & 0xc0) == 0x80)i++;
+    return i;
+}
+
+/*  Part of a UTF-8 character a byte is, the atom of it
+ *  in metaAtoms(): 'c' for a continuation byte, '2', '3'
+ *  or '4' for the lead byte of a 2, 3 or 4 bytes character,
+ *  0 for any other byte.   */
+static inline int utf8Atom(unsigned char b){
+    if(b < 0x80 || b == 0xc0 || b == 0xc1 || b > 0xf4)return 0;
+    return (b < 0xc0)? 'c': (b < 0xe0)? '2': (b < 0xf0)? '3': '4';
+}
+
+/*  Atoms of metaAtoms() of 'p', bytes neither word nor space  */
+#define ATOMS_OTHER (8|16|32|64|128)
 
-unsigned short escx0[127] = { 0x100, ['0'] = 0x0, ['1'] = 0x1, ['2'] = 0x2, ['3'] = 0x3, ['4'] = 0x4, ['5'] = 0x5, ['6'] = 0x6, ['7'] = 0x7, ['8'] = 0x8, ['9'] = 0x9, ['A'] = 0xa, ['B'] = 0xb, ['C'] = 0xc, ['D'] = 0xd, ['E'] = 0xe, ['F'] = 0xf, ['a'] = 0xa, ['b'] = 0xb, ['c'] = 0xc, ['d'] = 0xd, ['e'] = 0xe, ['f'] = 0xf };
+/*  At the end of the input, end if it is given,
+ *  or the terminating '\0'.   */
+#define INPUT_END(c) (end? (c) == end: *(c) == '\0')
+
+/*  Counters of the VM and the table of a thread, see
+ *  limregex_exec_count(), only built with LIMREGEX_STATS
+ *  as they cost a branch a byte.  */
+#ifdef LIMREGEX_STATS
+static _Thread_local struct limregex_exec_stats *execStats;
+#define EXEC_STEP() (execStats? (void)execStats->instructions++: (void)0)
+#define EXEC_BYTES(n) (execStats? (void)(execStats->bytes += (n)): (void)0)
+#define EXEC_VISIT(i) ((execStats && (size_t)(i) < execStats->visitsLen)? (void)execStats->visits[i]++: (void)0)
+
+/*  Count the matches of the calling thread.
+ *  @param  stats       Counters to add to, NULL to stop
+ */
+void limregex_exec_count(struct limregex_exec_stats *stats){
+    execStats = stats;
+}
+#else
+#define EXEC_STEP() ((void)0)
+#define EXEC_BYTES(n) ((void)0)
+#define EXEC_VISIT(i) ((void)0)
+#endif
 
 /*  Virtual Machine
+ *  A state accepting at its entry runs ACCEPTM1, one with
+ *  no move left jumps to ACCEPT.
  *  @param  str     Input String
+ *  @param  end     End of str[], or NULL for '\0' ended
  *  @param  regexvm limregexcl() compiled VM instructions
+ *  @param  mode    enum limregex_mode, 0 for limregexec():
+ *                  an accepting state with no move left, or
+ *                  one at the end of the input
  *  @return int     Match Length
  *                  >0  accepted
  *                  0   rejected
  */
-int limregexec(const char str[], int regexvm[]){
-    int *pc = regexvm;
+static inline int regexpVM(const char str[], const char *end, const int regexvm[], int mode){
+    const int *pc = regexvm;
     const char *c = str;
+    int charWidth;
+    /*  longest match so far    */
+    int match = 0;
+    /*  JMP over ACCEPTM1 of an accepting initial state  */
+    if(mode == LIMREGEX_IS_MATCH && regexvm[1] == VM_INIT + 2)return 1;
     for(;;){
+        EXEC_STEP();
         switch(*pc){
             case JMP:
                 pc = regexvm + pc[1];
                 break;
             case JEQ:
                 pc++;
-                if(*pc++ == *c)
-                    pc = regexvm + pc[0];
-                else pc++;
+                if(!INPUT_END(c) && *pc == (unsigned char)*c)
+                    pc = regexvm + pc[1];
+                else pc += 2;
                 break;
             case FRWRD:
+                EXEC_VISIT(pc - regexvm);
+                EXEC_BYTES(1);
                 c++;
                 pc++;
                 break;
             case JANY:/*    .   */
-                c += (mblen(c, MB_CUR_MAX)>0)?
-                    (mblen(c, MB_CUR_MAX)-1):1;
+                if(INPUT_END(c)){
+                    pc += 2;
+                    break;
+                }
+                charWidth = utf8Width(c, end? (size_t)(end - c): CHARW_MAX);
+                c += (charWidth>0)? (charWidth-1):0;
+                EXEC_BYTES((charWidth>0)? (charWidth-1):0);
                 pc = regexvm + pc[1];
                 break;
             case JDEG:
                 pc++;
-                if(isdigit(*c))
+                if(!INPUT_END(c) && IS_CHAR(CHAR_DIGIT, *c))
                     pc = regexvm + pc[0];
                 else pc++;
                 break;
             case JNDEG:
                 pc++;
-                if(isdigit(*c))pc++;
+                if(INPUT_END(c) || IS_CHAR(CHAR_DIGIT, *c))pc++;
                 else
                     pc = regexvm + pc[0];
                 break;
             case JWRD:
                 pc++;
-                if(isalnum(*c) || *c=='_')
+                if(!INPUT_END(c) && IS_CHAR(CHAR_WORD, *c))
                     pc = regexvm + pc[0];
                 else pc++;
                 break;
             case JNWRD:
                 pc++;
-                if(isalnum(*c) || *c=='_')pc++;
+                if(INPUT_END(c) || IS_CHAR(CHAR_WORD, *c))pc++;
                 else
                     pc = regexvm + pc[0];
                 break;
             case JSPC:
                 pc++;
-                if(isspace(*c))
+                if(!INPUT_END(c) && IS_CHAR(CHAR_SPACE, *c))
                     pc = regexvm + pc[0];
                 else pc++;
                 break;
             case JNSPC:
                 pc++;
-                if(isspace(*c))pc++;
+                if(INPUT_END(c) || IS_CHAR(CHAR_SPACE, *c))pc++;
                 else
                     pc = regexvm + pc[0];
                 break;
             case JNEQ:
                 pc++;
-                if(*pc++ == *c)pc++;
-                else pc = regexvm + pc[0];
+                if(INPUT_END(c) || *pc == (unsigned char)*c)pc += 2;
+                else pc = regexvm + pc[1];
+                break;
+            case JUTF8:/*   utf8Atom()  */
+                pc++;
+                if(!INPUT_END(c) && *pc == utf8Atom(*c))
+                    pc = regexvm + pc[1];
+                else pc += 2;
                 break;
             case FAIL:
-                return 0;
+                return (mode == LIMREGEX_LONGEST)? match: 0;
             case ACCEPT:
+                /*  the move into a state with no move left  */
+                EXEC_BYTES(1);
+                if(mode == LIMREGEX_IS_MATCH)return 1;
+                if(mode == LIMREGEX_FULL && !INPUT_END(c + 1))return 0;
                 return ( c - str + 1 );
             case ACCEPTM1:
-                if(c[1] == '\0')
+                if(mode == LIMREGEX_IS_MATCH)return 1;
+                if(mode == LIMREGEX_LONGEST)match = c - str + 1;
+                else if(INPUT_END(c + 1))
                     return ( c - str + 1);
             default: pc++;
         }
@@ -176,41 +502,954 @@ int limregexec(const char str[], int regexvm[]){
     return 0;
 }
 
+/*  Virtual Machine
+ *  @param  str     Input String
+ *  @param  regexvm limregexcl() compiled VM instructions
+ *  @return int     Match Length
+ *                  >0  accepted
+ *                  0   rejected
+ */
+int limregexec(const char str[], const int regexvm[]){
+    return regexpVM(str, NULL, regexvm, 0);
+}
+
+/*  Virtual Machine on a buffer, '\0' is a character.
+ *  @param  buf     Input buffer
+ *  @param  len     Length of buf[]
+ *  @param  regexvm limregexcl() or limregexcl_n()
+ *                  compiled VM instructions
+ *  @return int     Match Length
+ *                  >0  accepted
+ *                  0   rejected
+ */
+int limregexec_n(const char buf[], size_t len, const int regexvm[]){
+    return regexpVM(buf, buf + len, regexvm, 0);
+}
+
+/*  Virtual Machine in a match mode.
+ *  @param  str     Input String
+ *  @param  regexvm limregexcl() compiled VM instructions
+ *  @param  mode    LIMREGEX_IS_MATCH, LIMREGEX_LONGEST or
+ *                  LIMREGEX_FULL
+ *  @return int     Match Length, 1 for LIMREGEX_IS_MATCH
+ *                  >0  accepted
+ *                  0   rejected
+ */
+int limregexec_mode(const char str[], const int regexvm[], int mode){
+    switch(mode){
+        case LIMREGEX_IS_MATCH: return regexpVM(str, NULL, regexvm, LIMREGEX_IS_MATCH);
+        case LIMREGEX_LONGEST: return regexpVM(str, NULL, regexvm, LIMREGEX_LONGEST);
+        case LIMREGEX_FULL: return regexpVM(str, NULL, regexvm, LIMREGEX_FULL);
+    }
+    return regexpVM(str, NULL, regexvm, 0);
+}
+
+/*  Virtual Machine on a buffer in a match mode, '\0' is
+ *  a character.
+ *  @param  buf     Input buffer
+ *  @param  len     Length of buf[]
+ *  @param  regexvm limregexcl() or limregexcl_n()
+ *                  compiled VM instructions
+ *  @param  mode    LIMREGEX_IS_MATCH, LIMREGEX_LONGEST or
+ *                  LIMREGEX_FULL
+ *  @return int     Match Length, 1 for LIMREGEX_IS_MATCH
+ *                  >0  accepted
+ *                  0   rejected
+ */
+int limregexec_mode_n(const char buf[], size_t len, const int regexvm[], int mode){
+    switch(mode){
+        case LIMREGEX_IS_MATCH: return regexpVM(buf, buf + len, regexvm, LIMREGEX_IS_MATCH);
+        case LIMREGEX_LONGEST: return regexpVM(buf, buf + len, regexvm, LIMREGEX_LONGEST);
+        case LIMREGEX_FULL: return regexpVM(buf, buf + len, regexvm, LIMREGEX_FULL);
+    }
+    return regexpVM(buf, buf + len, regexvm, 0);
+}
+
+#ifndef RUN_SIMD
+/*  Scalar fallback, bytes are left to the table.  */
+static const unsigned char *runScalar(const unsigned char *c, const unsigned char *end, const unsigned char kernel[]){
+    (void)end;
+    (void)kernel;
+    return c;
+}
+#else
+/*  Aligned loads never cross a page, so reading past
+ *  the terminating '\0', which no kernel takes, or past
+ *  end within the last block is safe.
+ */
+__attribute__((no_sanitize_address))
+static const unsigned char *runSse2(const unsigned char *c, const unsigned char *end, const unsigned char kernel[]){
+    __m128i lo[KERNEL_RANGES], span[KERNEL_RANGES];
+    const __m128i zero = _mm_setzero_si128();
+    int rangeLen = kernel[0];
+    for(int r = 0; r<rangeLen; r++){
+        lo[r] = _mm_set1_epi8(kernel[1+r*2]);
+        span[r] = _mm_set1_epi8(kernel[2+r*2] - kernel[1+r*2]);
+    }
+    const __m128i *p = (const __m128i *)((uintptr_t)c & ~(uintptr_t)15);
+    unsigned int skip = 0xffffu << ((uintptr_t)c & 15);
+    for(; (const unsigned char *)p < end; p++, skip = 0xffffu){
+        __m128i x = _mm_load_si128(p);
+        __m128i in = zero;
+        for(int r = 0; r<rangeLen; r++)
+            in = _mm_or_si128(in, _mm_cmpeq_epi8(zero,
+                        _mm_subs_epu8(_mm_sub_epi8(x, lo[r]), span[r])));
+        unsigned int out = ~_mm_movemask_epi8(in) & skip;
+        if(out)return (const unsigned char *)p + __builtin_ctz(out);
+    }
+    return end;
+}
+
+__attribute__((no_sanitize_address, target("avx2")))
+static const unsigned char *runAvx2(const unsigned char *c, const unsigned char *end, const unsigned char kernel[]){
+    __m256i lo[KERNEL_RANGES], span[KERNEL_RANGES];
+    const __m256i zero = _mm256_setzero_si256();
+    int rangeLen = kernel[0];
+    for(int r = 0; r<rangeLen; r++){
+        lo[r] = _mm256_set1_epi8(kernel[1+r*2]);
+        span[r] = _mm256_set1_epi8(kernel[2+r*2] - kernel[1+r*2]);
+    }
+    const __m256i *p = (const __m256i *)((uintptr_t)c & ~(uintptr_t)31);
+    unsigned int skip = 0xffffffffu << ((uintptr_t)c & 31);
+    for(; (const unsigned char *)p < end; p++, skip = 0xffffffffu){
+        __m256i x = _mm256_load_si256(p);
+        __m256i in = zero;
+        for(int r = 0; r<rangeLen; r++)
+            in = _mm256_or_si256(in, _mm256_cmpeq_epi8(zero,
+                        _mm256_subs_epu8(_mm256_sub_epi8(x, lo[r]), span[r])));
+        unsigned int out = ~(unsigned int)_mm256_movemask_epi8(in) & skip;
+        if(out)return (const unsigned char *)p + __builtin_ctz(out);
+    }
+    return end;
+}
+#endif
+
+static const unsigned char *(*runKernel)(const unsigned char *, const unsigned char *, const unsigned char []);
+static pthread_once_t runOnce = PTHREAD_ONCE_INIT;
+
+/*  Choose the run kernel by cpuid, once for all threads   */
+static void runInit(void){
+#ifdef RUN_SIMD
+    __builtin_cpu_init();
+    runKernel = __builtin_cpu_supports("avx2")? runAvx2: runSse2;
+#else
+    runKernel = runScalar;
+#endif
+}
+
+/*  No end for regexpRun(), the string ends with '\0'  */
+#define RUN_NOEND ((const unsigned char *)UINTPTR_MAX)
+
+/*  Skip bytes of a run kernel before end, the kernel is
+ *  chosen by cpuid on first use.
+ *  @return Pointer to the first byte out of the kernel,
+ *          or end
+ */
+static const unsigned char *regexpRun(const unsigned char *c, const unsigned char *end, const unsigned char kernel[]){
+    pthread_once(&runOnce, runInit);
+    c = runKernel(c, end, kernel);
+    return (c < end)? c: end;
+}
+
+/*  Table driven DFA
+ *  @param  str     Input String
+ *  @param  end     End of str[], or NULL for '\0' ended
+ *  @param  table   limregex_compile_table() compiled table
+ *  @param  mode    enum limregex_mode, LIMREGEX_LONGEST
+ *                  unless it is LIMREGEX_IS_MATCH or
+ *                  LIMREGEX_FULL
+ *  @return int     Length of the longest match,
+ *                  1 for LIMREGEX_IS_MATCH
+ */
+static inline int regexpExecTable(const unsigned char str[], const unsigned char *end, const int table[], int mode){
+    const int *delta = table + TBL_DELTA;
+    const unsigned char *map = (const unsigned char *)(table + TBL_CLASSMAP);
+    const unsigned char *kernel = (const unsigned char *)(table + TBL_KERNEL);
+    const unsigned char *runEnd = end? end: RUN_NOEND;
+    const int accept = table[TBL_ACCEPT];
+    const unsigned char *c = str;
+    int state = table[TBL_START];
+    int match = 0;
+    if(mode == LIMREGEX_IS_MATCH && state >= accept)return 1;
+    while(!INPUT_END(c) && state){
+        EXEC_STEP();
+        EXEC_BYTES(1);
+        int next = delta[state + map[*c++]];
+        EXEC_VISIT(next / table[TBL_CLASSES]);
+        if(next == state && delta[state]){
+            const unsigned char *run = regexpRun(c, runEnd, kernel + (delta[state]-1)*KERNEL_SIZE);
+            EXEC_BYTES(run - c);
+            c = run;
+        }
+        state = next;
+        if(state >= accept){
+            if(mode == LIMREGEX_IS_MATCH)return 1;
+            match = c - str;
+        }
+    }
+    if(mode == LIMREGEX_FULL)
+        return (INPUT_END(c) && state >= accept)? c - str: 0;
+    return match;
+}
+
+/*  Table driven DFA
+ *  @param  str     Input String
+ *  @param  table   limregex_compile_table() compiled table
+ *  @return int     Length of the longest match
+ *                  >0  accepted
+ *                  0   rejected
+ */
+int limregex_exec_table(const char str[], const int table[]){
+    return regexpExecTable((const unsigned char *)str, NULL, table, LIMREGEX_LONGEST);
+}
+
+/*  Table driven DFA on a buffer, '\0' is a character.
+ *  @param  buf     Input buffer
+ *  @param  len     Length of buf[]
+ *  @param  table   limregex_compile_table() compiled table
+ *  @return int     Length of the longest match
+ *                  >0  accepted
+ *                  0   rejected
+ */
+int limregex_exec_table_n(const char buf[], size_t len, const int table[]){
+    return regexpExecTable((const unsigned char *)buf, (const unsigned char *)buf + len, table, LIMREGEX_LONGEST);
+}
+
+/*  Table driven DFA in a match mode.
+ *  @param  str     Input String
+ *  @param  table   limregex_compile_table() compiled table
+ *  @param  mode    LIMREGEX_IS_MATCH, LIMREGEX_LONGEST or
+ *                  LIMREGEX_FULL
+ *  @return int     Match Length, 1 for LIMREGEX_IS_MATCH
+ *                  >0  accepted
+ *                  0   rejected
+ */
+int limregex_exec_table_mode(const char str[], const int table[], int mode){
+    switch(mode){
+        case LIMREGEX_IS_MATCH: return regexpExecTable((const unsigned char *)str, NULL, table, LIMREGEX_IS_MATCH);
+        case LIMREGEX_FULL: return regexpExecTable((const unsigned char *)str, NULL, table, LIMREGEX_FULL);
+    }
+    return regexpExecTable((const unsigned char *)str, NULL, table, LIMREGEX_LONGEST);
+}
+
+/*  Table driven DFA on a buffer in a match mode, '\0' is
+ *  a character.
+ *  @param  buf     Input buffer
+ *  @param  len     Length of buf[]
+ *  @param  table   limregex_compile_table() compiled table
+ *  @param  mode    LIMREGEX_IS_MATCH, LIMREGEX_LONGEST or
+ *                  LIMREGEX_FULL
+ *  @return int     Match Length, 1 for LIMREGEX_IS_MATCH
+ *                  >0  accepted
+ *                  0   rejected
+ */
+int limregex_exec_table_mode_n(const char buf[], size_t len, const int table[], int mode){
+    const unsigned char *b = (const unsigned char *)buf;
+    switch(mode){
+        case LIMREGEX_IS_MATCH: return regexpExecTable(b, b + len, table, LIMREGEX_IS_MATCH);
+        case LIMREGEX_FULL: return regexpExecTable(b, b + len, table, LIMREGEX_FULL);
+    }
+    return regexpExecTable(b, b + len, table, LIMREGEX_LONGEST);
+}
+
+/*  Match fields of a batch one lane each, at most
+ *  BATCH_STEPS bytes of every lane between the checks
+ *  for lanes which ended or died. Anchored rows of less
+ *  than BATCH_TABLE_MIN int stay in the cache, fields
+ *  are matched one by one then.  */
+#define BATCH_LANES 8
+#define BATCH_STEPS 16
+#define BATCH_TABLE_MIN (1<<13)
+
+/*  Table driven DFA on many short fields, such as a
+ *  column of strings, each the same as limregex_exec_table_n().
+ *  BATCH_LANES fields are run at once, a byte of each in
+ *  turn, so that the cache misses of a large table overlap.
+ *  @param  data    Bytes of all the fields
+ *  @param  offsets Field i is data[offsets[i]] ...
+ *                  data[offsets[i+1]-1], n+1 offsets
+ *  @param  n       Number of fields
+ *  @param  table   limregex_compile_table() compiled table
+ *  @param  bitmap  Array to store 1 bit a field, set if it
+ *                  matches, bit i%8 of bitmap[i/8], or NULL
+ *  @param  lengths Array to store the length of the longest
+ *                  match of each field, or NULL
+ *  @return size_t  Number of matched fields
+ */
+size_t limregex_exec_batch(const char data[], const uint32_t offsets[], size_t n, const int table[], unsigned char bitmap[], int lengths[]){
+    const int *delta = table + TBL_DELTA;
+    const unsigned char *map = (const unsigned char *)(table + TBL_CLASSMAP);
+    const unsigned char *buf = (const unsigned char *)data;
+    const int accept = table[TBL_ACCEPT];
+    const unsigned char *c[BATCH_LANES], *end[BATCH_LANES];
+    const unsigned char *start[BATCH_LANES], *matchEnd[BATCH_LANES];
+    int state[BATCH_LANES];
+    size_t field[BATCH_LANES];
+    size_t next = 0, matched = 0;
+    int lanes = 0;
+    if(bitmap)memset(bitmap, 0, (n+7)/8);
+    if(table[TBL_SEARCH_START] < BATCH_TABLE_MIN){
+        for(size_t i = 0; i<n; i++){
+            int len = regexpExecTable(buf + offsets[i], buf + offsets[i+1], table, LIMREGEX_LONGEST);
+            matched += len > 0;
+            if(lengths)lengths[i] = len;
+            if(bitmap)bitmap[i/8] |= (len > 0) << i%8;
+        }
+        return matched;
+    }
+    for(;;){
+        while(lanes < BATCH_LANES && next < n){
+            start[lanes] = matchEnd[lanes] = c[lanes] = buf + offsets[next];
+            end[lanes] = buf + offsets[next+1];
+            state[lanes] = table[TBL_START];
+            field[lanes++] = next++;
+        }
+        if(!lanes)break;
+        ptrdiff_t steps = BATCH_STEPS;
+        for(int l = 0; l<lanes; l++)
+            if(end[l] - c[l] < steps)steps = end[l] - c[l];
+        /*  no lane ends in these steps, a dead one stays
+         *  on row 0 */
+        for(; steps > 0; steps--)
+            for(int l = 0; l<lanes; l++){
+                int s = delta[state[l] + map[*c[l]++]];
+                state[l] = s;
+                matchEnd[l] = (s >= accept)? c[l]: matchEnd[l];
+            }
+        for(int l = 0; l<lanes; ){
+            if(c[l] < end[l] && state[l]){
+                l++;
+                continue;
+            }
+            int len = matchEnd[l] - start[l];
+            matched += len > 0;
+            if(lengths)lengths[field[l]] = len;
+            if(bitmap)bitmap[field[l]/8] |= (len > 0) << field[l]%8;
+            /*  the last lane takes its place   */
+            lanes--;
+            c[l] = c[lanes];
+            end[l] = end[lanes];
+            start[l] = start[lanes];
+            matchEnd[l] = matchEnd[lanes];
+            state[l] = state[lanes];
+            field[l] = field[lanes];
+        }
+    }
+    return matched;
+}
+
+/*  Find a literal in [s, end) with memchr().
+ *  @return Pointer to the literal, or NULL
+ */
+static const unsigned char *literalFind(const unsigned char *s, const unsigned char *end, const unsigned char literal[], int literalLen){
+    while(end - s >= literalLen
+            && (s = memchr(s, literal[0], end - s - literalLen + 1))){
+        if(memcmp(s + 1, literal + 1, literalLen - 1) == 0)
+            return s;
+        s++;
+    }
+    return NULL;
+}
+
+/*  Unanchored search with the table
+ *  @param  str     Input String
+ *  @param  end     End of str[], or NULL for '\0' ended
+ *  @param  table   limregex_compile_table() compiled table
+ *  @param  start   Offset of the match in str
+ *  @return int     Length of the leftmost longest match
+ */
+static int regexpSearch(const unsigned char str[], const unsigned char *end, const int table[], int *start){
+    const int *delta = table + TBL_DELTA;
+    const unsigned char *map = (const unsigned char *)(table + TBL_CLASSMAP);
+    const unsigned int *first = (const unsigned int *)(table + TBL_FIRSTBYTE);
+    const unsigned char *literal = (const unsigned char *)(table + TBL_LITERAL);
+    const unsigned char *kernel = (const unsigned char *)(table + TBL_KERNEL);
+    const int prefixLen = table[TBL_PREFIX_LEN];
+    const int factorLen = table[TBL_FACTOR_LEN];
+    const int init = table[TBL_SEARCH_START];
+    const int accept = table[TBL_SEARCH_ACCEPT];
+    const unsigned char *c = str;
+    /*  no match begins before from */
+    const unsigned char *from = str;
+    int state = init;
+    if(!end && (prefixLen || factorLen))
+        end = str + strlen((const char *)str);
+    if(factorLen && !literalFind(str, end, literal + LITERAL_MAX, factorLen))
+        return 0;
+    const unsigned char *runEnd = end? end: RUN_NOEND;
+    /*  end of the earliest match   */
+    for(;;){
+        if(state == init){
+            if(prefixLen){
+                if(!(c = literalFind(c, end, literal, prefixLen)))
+                    return 0;
+            }else
+                while(!INPUT_END(c) && !(first[*c>>5] >> (*c&31) & 1))c++;
+            from = c;
+        }
+        if(INPUT_END(c))return 0;
+        int next = delta[state + map[*c++]];
+        if(next == state && delta[state])
+            c = regexpRun(c, runEnd, kernel + (delta[state]-1)*KERNEL_SIZE);
+        state = next;
+        if(state >= accept)break;
+    }
+    /*  leftmost match begins before that end, by the
+     *  reverse rows read back from it: not after the
+     *  start of the leftmost match ending there, not
+     *  before the start of the leftmost match alive there */
+    const unsigned char *live = from, *last = c;
+    if(table[TBL_REVERSE_START]){
+        const int reverseAccept = table[TBL_REVERSE_ACCEPT];
+        int exact = table[TBL_REVERSE_START];
+        int alive = table[TBL_REVERSE_LIVE];
+        live = c;
+        for(const unsigned char *b = c; b > from && alive; ){
+            int k = map[*--b];
+            exact = delta[exact + k];
+            alive = delta[alive + k];
+            if(exact >= reverseAccept)last = b;
+            if(alive >= reverseAccept)live = b;
+        }
+    }
+    for(const unsigned char *b = live; b <= last && b < c; b++){
+        if(!(first[*b>>5] >> (*b&31) & 1))continue;
+        int len = regexpExecTable(b, end, table, LIMREGEX_LONGEST);
+        if(len > 0){
+            *start = b - str;
+            return len;
+        }
+    }
+    return 0;
+}
+
+/*  Unanchored search with the table
+ *  @param  str     Input String
+ *  @param  table   limregex_compile_table() compiled table
+ *  @param  start   Offset of the match in str
+ *  @return int     Length of the leftmost longest match
+ *                  >0  found
+ *                  0   not found
+ */
+int limregex_search(const char str[], const int table[], int *start){
+    return regexpSearch((const unsigned char *)str, NULL, table, start);
+}
+
+/*  Unanchored search with the table on a buffer,
+ *  '\0' is a character.
+ *  @param  buf     Input buffer
+ *  @param  len     Length of buf[]
+ *  @param  table   limregex_compile_table() compiled table
+ *  @param  start   Offset of the match in buf
+ *  @return int     Length of the leftmost longest match
+ *                  >0  found
+ *                  0   not found
+ */
+int limregex_search_n(const char buf[], size_t len, const int table[], int *start){
+    return regexpSearch((const unsigned char *)buf, (const unsigned char *)buf + len, table, start);
+}
+
+/*  Match a pattern set anywhere in a string in one pass.
+ *  @param  str     Input String
+ *  @param  end     End of str[], or NULL for '\0' ended
+ *  @param  table   limregex_set_compile() compiled table
+ *  @param  ids     Array to store the bitmap of matched
+ *                  patterns, pattern n is bit n%32 of
+ *                  ids[n/32], (n+31)/32 elements
+ *  @return int     Number of matched patterns
+ */
+static int regexpSetMatch(const unsigned char str[], const unsigned char *end, const int table[], unsigned int ids[]){
+    const int *delta = table + TBL_DELTA;
+    const unsigned char *map = (const unsigned char *)(table + TBL_CLASSMAP);
+    const unsigned int *first = (const unsigned int *)(table + TBL_FIRSTBYTE);
+    const unsigned char *literal = (const unsigned char *)(table + TBL_LITERAL);
+    const unsigned char *kernel = (const unsigned char *)(table + TBL_KERNEL);
+    const int *rowSet = table + table[TBL_PATTERN_SET];
+    const int patterns = table[TBL_PATTERNS];
+    const int words = SET_WORDS(patterns);
+    const int classLen = table[TBL_CLASSES];
+    const int prefixLen = table[TBL_PREFIX_LEN];
+    const int factorLen = table[TBL_FACTOR_LEN];
+    const int init = table[TBL_SEARCH_START];
+    const int accept = table[TBL_SEARCH_ACCEPT];
+    const unsigned char *c = str;
+    int state = init;
+    /*  accepting row last added to ids[]   */
+    int added = 0;
+    int found = 0;
+    memset(ids, 0, sizeof(int)*words);
+    if(!patterns)return 0;
+    if(prefixLen || factorLen){
+        if(!end)end = c + strlen((const char *)str);
+        if(factorLen && !literalFind(c, end, literal + LITERAL_MAX, factorLen))
+            return 0;
+    }
+    /*  patterns matching ""    */
+    if(table[TBL_START] >= table[TBL_ACCEPT])
+        added = table[TBL_START];
+    for(;;){
+        if(added){
+            const unsigned int *set = (const unsigned int *)table + rowSet[added/classLen];
+            for(int w = 0; w<words; w++){
+                unsigned int add = set[w] & ~ids[w];
+                ids[w] |= add;
+                for(; add; add &= add - 1)found++;
+            }
+            if(found == patterns)return found;
+        }
+        /*  next accepting row  */
+        do{
+            if(state == init){
+                if(prefixLen){
+                    if(!(c = literalFind(c, end, literal, prefixLen)))
+                        return found;
+                }else
+                    while(!INPUT_END(c) && !(first[*c>>5] >> (*c&31) & 1))c++;
+            }
+            if(INPUT_END(c))return found;
+            int next = delta[state + map[*c++]];
+            if(next == state && delta[state])
+                c = regexpRun(c, end? end: RUN_NOEND, kernel + (delta[state]-1)*KERNEL_SIZE);
+            state = next;
+        }while(state < accept || state == added);
+        added = state;
+    }
+}
+
+/*  Match a pattern set anywhere in a string in one pass.
+ *  @param  str     Input String
+ *  @param  table   limregex_set_compile() compiled table
+ *  @param  ids     Array to store the bitmap of matched
+ *                  patterns, pattern n is bit n%32 of
+ *                  ids[n/32], (n+31)/32 elements
+ *  @return int     Number of matched patterns
+ */
+int limregex_set_match(const char str[], const int table[], unsigned int ids[]){
+    return regexpSetMatch((const unsigned char *)str, NULL, table, ids);
+}
+
+/*  Match a pattern set anywhere in a buffer in one pass,
+ *  '\0' is a character.
+ *  @param  buf     Input buffer
+ *  @param  len     Length of buf[]
+ *  @param  table   limregex_set_compile() compiled table
+ *  @param  ids     Array to store the bitmap of matched
+ *                  patterns, as limregex_set_match()
+ *  @return int     Number of matched patterns
+ */
+int limregex_set_match_n(const char buf[], size_t len, const int table[], unsigned int ids[]){
+    return regexpSetMatch((const unsigned char *)buf, (const unsigned char *)buf + len, table, ids);
+}
+
+/*  Start an unanchored search over a stream of chunks.
+ *  @param  stream  Stream state to initialize
+ *  @param  table   limregex_compile_table() compiled table
+ */
+void limregex_stream_init(struct limregex_stream *stream, const int table[]){
+    stream->table = table;
+    stream->state = table[TBL_SEARCH_START];
+    stream->offset = 0;
+    stream->match = -1;
+}
+
+/*  Search the next chunk of a stream, a match may span
+ *  chunks, no chunk is kept after the call.
+ *  '\0' is a character.
+ *  @param  stream  limregex_stream_init() initialized
+ *  @param  buf     Chunk of the stream
+ *  @param  len     Length of buf[]
+ *  @return int     1 if a match has ended, later chunks
+ *                  are ignored
+ *                  0   not found yet
+ */
+int limregex_stream_feed(struct limregex_stream *stream, const char buf[], size_t len){
+    const int *table = stream->table;
+    const int *delta = table + TBL_DELTA;
+    const unsigned char *map = (const unsigned char *)(table + TBL_CLASSMAP);
+    const unsigned int *first = (const unsigned int *)(table + TBL_FIRSTBYTE);
+    const unsigned char *kernel = (const unsigned char *)(table + TBL_KERNEL);
+    const int init = table[TBL_SEARCH_START];
+    const int accept = table[TBL_SEARCH_ACCEPT];
+    const unsigned char *c = (const unsigned char *)buf;
+    const unsigned char *end = c + len;
+    int state = stream->state;
+    if(stream->match >= 0)return 1;
+    while(c < end){
+        if(state == init){
+            while(c < end && !(first[*c>>5] >> (*c&31) & 1))c++;
+            if(c == end)break;
+        }
+        int next = delta[state + map[*c++]];
+        if(next == state && delta[state])
+            c = regexpRun(c, end, kernel + (delta[state]-1)*KERNEL_SIZE);
+        state = next;
+        if(state >= accept){
+            stream->match = stream->offset + (c - (const unsigned char *)buf);
+            break;
+        }
+    }
+    stream->state = state;
+    stream->offset += c - (const unsigned char *)buf;
+    return stream->match >= 0;
+}
+
+/*  End a stream.
+ *  @param  stream  limregex_stream_init() initialized
+ *  @return long long   Offset in the stream of the end of
+ *                      the match which ends first
+ *                      <0  not found
+ */
+long long limregex_stream_end(struct limregex_stream *stream){
+    return stream->match;
+}
+
+/*  Chunk of limregex_search_parallel() and its map
+ *  from each entry search row to where the chunk leaves it.
+ *  entries:    Number of non-accepting search rows
+ *  final:      Row the chunk ends in, per entry row
+ *  match:      End of the first match in the chunk, per
+ *              entry row, -1 for none
+ *  stop:       Set once the first chunk has a match, the
+ *              map is not needed then
+ */
+struct searchChunk{
+    const int *table;
+    atomic_int *stop;
+    const unsigned char *buf;
+    size_t len;
+    int entries;
+    int *final;
+    long long *match;
+};
+
+/*  Run a chunk from every non-accepting search row at
+ *  once. Runs reaching the same row merge and go on as
+ *  one, the last one left runs with the stream search.
+ *  @param  arg struct searchChunk of the chunk
+ *  @return void*   NULL
+ */
+static void *regexpSearchMap(void *arg){
+    struct searchChunk *chunk = arg;
+    const int *table = chunk->table;
+    const int *delta = table + TBL_DELTA;
+    const unsigned char *map = (const unsigned char *)(table + TBL_CLASSMAP);
+    const int classLen = table[TBL_CLASSES];
+    const int init = table[TBL_SEARCH_START];
+    const int accept = table[TBL_SEARCH_ACCEPT];
+    const int entries = chunk->entries;
+    /*  run l goes on as run parent[l] once they merge  */
+    int *parent = chunk->final;
+    long long *match = chunk->match;
+    int state[entries];
+    int active[entries];
+    /*  run in each row, -1 for none    */
+    int rowRun[entries];
+    int activeLen = entries;
+    size_t i = 0;
+    for(int l = 0; l<entries; l++){
+        state[l] = init + l*classLen;
+        active[l] = l;
+        parent[l] = -1;
+        match[l] = -1;
+        rowRun[l] = -1;
+    }
+    for(; i < chunk->len && activeLen > 1; i++){
+        if(!(i % PARALLEL_CHUNK) && atomic_load(chunk->stop))return NULL;
+        int k = map[chunk->buf[i]];
+        int n = 0;
+        for(int a = 0; a<activeLen; a++){
+            int l = active[a];
+            int next = delta[state[l] + k];
+            state[l] = next;
+            if(next >= accept){
+                match[l] = i+1;
+                continue;
+            }
+            int row = (next - init)/classLen;
+            if(rowRun[row] >= 0){
+                parent[l] = rowRun[row];
+                continue;
+            }
+            rowRun[row] = l;
+            active[n++] = l;
+        }
+        activeLen = n;
+        for(int a = 0; a<activeLen; a++)
+            rowRun[(state[active[a]] - init)/classLen] = -1;
+    }
+    if(activeLen == 1){
+        struct limregex_stream stream = {
+            .table = table, .state = state[active[0]], .offset = i, .match = -1 };
+        for(; i < chunk->len && stream.match < 0; i += PARALLEL_CHUNK){
+            if(atomic_load(chunk->stop))return NULL;
+            size_t n = (chunk->len - i < PARALLEL_CHUNK)? chunk->len - i: PARALLEL_CHUNK;
+            limregex_stream_feed(&stream, (const char *)chunk->buf + i, n);
+        }
+        state[active[0]] = stream.state;
+        match[active[0]] = stream.match;
+    }
+    /*  parents are found before children merge,
+     *  follow them from the end    */
+    for(int l = 0; l<entries; l++){
+        int r = l;
+        while(match[r] < 0 && parent[r] >= 0)r = parent[r];
+        match[l] = match[r];
+        state[l] = state[r];
+    }
+    for(int l = 0; l<entries; l++)
+        chunk->final[l] = state[l];
+    return NULL;
+}
+
+/*  Unanchored search of a large buffer by threads.
+ *  The buffer is cut into a chunk a thread, each chunk
+ *  after the first is mapped from every search row, and
+ *  the maps are followed from the first chunk.
+ *  '\0' is a character.
+ *  @param  buf     Input buffer
+ *  @param  len     Length of buf[]
+ *  @param  table   limregex_compile_table() compiled table
+ *  @param  threads Number of threads
+ *  @return long long   Offset of the end of the match
+ *                      which ends first, the same as
+ *                      limregex_stream_end()
+ *                      <0  not found
+ */
+long long limregex_search_parallel(const char buf[], size_t len, const int table[], int threads){
+    const int classLen = table[TBL_CLASSES];
+    const int init = table[TBL_SEARCH_START];
+    const int entries = (table[TBL_SEARCH_ACCEPT] - init)/classLen;
+    struct limregex_stream stream;
+    /*  a chunk of at least PARALLEL_CHUNK bytes    */
+    if(threads > (int)(len/PARALLEL_CHUNK))threads = len/PARALLEL_CHUNK;
+    struct searchChunk chunk[threads > 1? threads: 1];
+    pthread_t thread[threads > 1? threads: 1];
+    int *final = NULL;
+    long long *match = NULL;
+    if(threads > 1){
+        final = malloc(sizeof(int)*entries*threads);
+        match = malloc(sizeof(long long)*entries*threads);
+    }
+    if(!final || !match){
+        free(final);
+        free(match);
+        limregex_stream_init(&stream, table);
+        limregex_stream_feed(&stream, buf, len);
+        return limregex_stream_end(&stream);
+    }
+    atomic_int stop = 0;
+    int started = 1;
+    for(int t = 0; t<threads; t++){
+        size_t from = len/threads*t;
+        chunk[t] = (struct searchChunk){
+            .table = table, .stop = &stop,
+            .buf = (const unsigned char *)buf + from,
+            .len = (t+1 < threads)? len/threads: len - from,
+            .entries = entries,
+            .final = final + entries*t, .match = match + entries*t };
+        if(t && started == t
+                && !pthread_create(&thread[t], NULL, regexpSearchMap, &chunk[t]))
+            started++;
+    }
+    /*  the first chunk begins in the initial row   */
+    limregex_stream_init(&stream, table);
+    if(limregex_stream_feed(&stream, (const char *)chunk[0].buf, chunk[0].len))
+        atomic_store(&stop, 1);
+    for(int t = 1; t<threads; t++)
+        if(t < started)pthread_join(thread[t], NULL);
+        else regexpSearchMap(&chunk[t]);
+    long long found = stream.match;
+    int state = stream.state;
+    size_t from = chunk[0].len;
+    for(int t = 1; t<threads && found < 0; t++){
+        int l = (state - init)/classLen;
+        if(chunk[t].match[l] >= 0)found = from + chunk[t].match[l];
+        state = chunk[t].final[l];
+        from += chunk[t].len;
+    }
+    free(final);
+    free(match);
+    return found;
+}
+
+static void *allocatorAlloc(const struct limregex_allocator *allocator, size_t size){
+    return allocator->alloc? allocator->alloc(size, allocator->data): malloc(size);
+}
+
+static void allocatorFree(const struct limregex_allocator *allocator, void *ptr, size_t size){
+    if(allocator->free)allocator->free(ptr, size, allocator->data);
+    else if(!allocator->alloc)free(ptr);
+}
+
+/*  Take size bytes from an arena.
+ *  @return void*   NULL for no memory
+ */
+static void *arenaAlloc(struct regexpArena *arena, size_t size){
+    if(!arena)return malloc(size? size: 1);
+    size = ARENA_ROUND(size);
+    size_t need = ARENA_ROUND(sizeof(struct arenaHead)) + size;
+    struct arenaBlock *block = arena->block;
+    if(!block || block->used + need > block->size){
+        size_t blockSize = block? block->size*2: ARENA_BLOCK_MIN;
+        if(blockSize < need)blockSize = need;
+        struct arenaBlock *newBlock = allocatorAlloc(&arena->allocator,
+                ARENA_ROUND(sizeof(struct arenaBlock)) + blockSize);
+        if(!newBlock)return NULL;
+        newBlock->next = block;
+        newBlock->size = blockSize;
+        newBlock->used = 0;
+        arena->block = block = newBlock;
+    }
+    struct arenaHead *head = (struct arenaHead *)(ARENA_DATA(block) + block->used);
+    head->size = size;
+    head->prev = block->used;
+    block->used += need;
+    return (char *)head + ARENA_ROUND(sizeof(struct arenaHead));
+}
+
+static void *arenaCalloc(struct regexpArena *arena, size_t n, size_t size){
+    if(!arena)return calloc(n? n: 1, size);
+    void *ptr = arenaAlloc(arena, n*size);
+    if(ptr)memset(ptr, 0, n*size);
+    return ptr;
+}
+
+static struct arenaHead *arenaHeadOf(void *ptr){
+    return (struct arenaHead *)((char *)ptr - ARENA_ROUND(sizeof(struct arenaHead)));
+}
+
+/*  The newest piece of the newest block    */
+static int arenaIsTop(const struct regexpArena *arena, void *ptr){
+    const struct arenaBlock *block = arena->block;
+    return block && (char *)ptr + arenaHeadOf(ptr)->size == ARENA_DATA(block) + block->used;
+}
+
+/*  Give back a piece, only the newest one is reused
+ *  before arenaReset().  */
+static void arenaFree(struct regexpArena *arena, void *ptr){
+    if(!arena){
+        free(ptr);
+        return;
+    }
+    if(ptr && arenaIsTop(arena, ptr))
+        arena->block->used = arenaHeadOf(ptr)->prev;
+}
+
+/*  Grow or shrink a piece, the newest one in place.
+ *  @return void*   NULL for no memory, ptr is kept
+ */
+static void *arenaRealloc(struct regexpArena *arena, void *ptr, size_t size){
+    if(!arena)return realloc(ptr, size? size: 1);
+    if(!ptr)return arenaAlloc(arena, size);
+    struct arenaHead *head = arenaHeadOf(ptr);
+    size = ARENA_ROUND(size);
+    if(arenaIsTop(arena, ptr)
+            && arena->block->used - head->size + size <= arena->block->size){
+        arena->block->used = arena->block->used - head->size + size;
+        head->size = size;
+        return ptr;
+    }
+    if(size <= head->size)return ptr;
+    void *newPtr = arenaAlloc(arena, size);
+    if(newPtr)memcpy(newPtr, ptr, head->size);
+    return newPtr;
+}
+
+/*  Give back all pieces, blocks are joined into one
+ *  so that the next compile of the same size takes no
+ *  more blocks.  */
+static void arenaReset(struct regexpArena *arena){
+    struct arenaBlock *block = arena->block;
+    if(!block)return;
+    if(!block->next){
+        block->used = 0;
+        return;
+    }
+    size_t size = 0;
+    while(block){
+        struct arenaBlock *next = block->next;
+        size += block->size;
+        allocatorFree(&arena->allocator, block, ARENA_ROUND(sizeof(struct arenaBlock)) + block->size);
+        block = next;
+    }
+    arena->block = allocatorAlloc(&arena->allocator, ARENA_ROUND(sizeof(struct arenaBlock)) + size);
+    if(arena->block)
+        *arena->block = (struct arenaBlock){ .next = NULL, .size = size, .used = 0 };
+}
+
+static void arenaDestroy(struct regexpArena *arena){
+    for(struct arenaBlock *block = arena->block; block;){
+        struct arenaBlock *next = block->next;
+        allocatorFree(&arena->allocator, block, ARENA_ROUND(sizeof(struct arenaBlock)) + block->size);
+        block = next;
+    }
+    arena->block = NULL;
+}
+
 /*  qsort() NFA moves compare function for sortNfa()
 */
 static int nfaCmp(const void *ap, const void *bp){
     const struct FAdelta *a = *(struct FAdelta **)ap;
     const struct FAdelta *b = *(struct FAdelta **)bp;
-    if(a->input == EXTRACT_FLAG && b->input == EXTRACT_FLAG)return (0);
-    else if(b->input == EXTRACT_FLAG)return (1);
-    else if(a->input == EXTRACT_FLAG)return (-1);
-    else return (a->before - b->before)?(a->before - b->before):(b->input - a->input);
+    return (a->before - b->before)?(a->before - b->before):(b->input - a->input);
+}
+
+/*  Byte set of a metachar, as a union of disjoint atoms:
+ *  1 digit, 2 other word character, 4 space, 8 the rest
+ *  of the bytes 'o', 16 UTF-8 continuation bytes 'c',
+ *  32, 64 and 128 lead bytes of 2, 3 and 4 bytes UTF-8
+ *  characters '2', '3' and '4', 'p' is the last five.
+ */
+static int metaAtoms(int input){
+    if(!(input & METACHAR))return 0;
+    switch(input & 0xff){
+        case 'd': return 1;
+        case 'w': return 1|2;
+        case 's': return 4;
+        case 'W': return 4|ATOMS_OTHER;
+        case 'D': return 2|4|ATOMS_OTHER;
+        case 'S': return 1|2|ATOMS_OTHER;
+        case '.': return 1|2|4|ATOMS_OTHER;
+        case 'l': return 2;
+        case 'p': return ATOMS_OTHER;
+        case 'o': return 8;
+        case 'c': return 16;
+        case '2': return 32;
+        case '3': return 64;
+        case '4': return 128;
+    }
+    return 0;
+}
+
+/*  Order of DFA moves: literals, then metachars of fewer
+ *  atoms, so a metachar is tried before its supersets.  */
+static int metaRank(int input){
+    int atoms = metaAtoms(input);
+    if(!atoms)return input;
+    int count = 0;
+    for(; atoms; atoms &= atoms-1)count++;
+    return METACHAR + count*0x100 + (input & 0xff);
 }
 
 /*  qsort() DFA moves compare function for sortDfa()    */
 static int dfaCmp(const void *ap, const void *bp){
     const struct FAdelta *a = *(struct FAdelta **)ap;
     const struct FAdelta *b = *(struct FAdelta **)bp;
-    if(a->input == EXTRACT_FLAG && b->input == EXTRACT_FLAG)return (0);
-    else if(b->input == EXTRACT_FLAG)return (1);
-    else if(a->input == EXTRACT_FLAG)return (-1);
-    else return (a->before - b->before)?(a->before - b->before):(a->input - b->input);
+    return (a->before - b->before)?(a->before - b->before):(metaRank(a->input) - metaRank(b->input));
 }
 
 /*  Sorting an array of pointers instead sorting
  *  the NFA moves array.
- *  1.  All moves with mark EXTRACT_FLAG are at the top.
- *  2.  Moves with metachar or epsilon-move mark
- *      are at the top, then is other moves with the
- *      same prev state.
+ *  Moves with metachar or epsilon-move mark
+ *  are at the top, then is other moves with the
+ *  same prev state.
  */
 static void sortNfa(struct FAdelta *nfaDeltaRef[], int nfaDeltaLen){
     qsort(nfaDeltaRef, nfaDeltaLen, sizeof(struct FAdelta *), nfaCmp);
 }
 
 /*  Sorting an array of pointers instead sorting
- *  the DFA moves array.
- *  1.  All moves with mark EXTRACT_FLAG are at the top.
+ *  the DFA moves array, by prev state, then input.
  */
 static void sortDfa(struct FAdelta *dfaDeltaRef[], int dfaDeltaLen){
     qsort(dfaDeltaRef, dfaDeltaLen, sizeof(struct FAdelta *), dfaCmp);
@@ -221,26 +1460,37 @@ static void sortDfa(struct FAdelta *dfaDeltaRef[], int dfaDeltaLen){
  *  
  *  @param  post        Array to store postfix expression
  *  @param  postSize    Allocated size of post[]
- *  @param  regexp      Infix RegExp string
+ *  @param  regexpIn    Infix RegExp string, may hold '\0'
  *  @param  regexpSize  Input RegExp string length
+ *  @param  stack       Space of regexpSize operators
+ *  @param  pad         Space of regexpSize+5 chars
  *  @return int     Length of the expression in post[]
  */
-static unsigned int regexpPost(unsigned int post[], unsigned int postSize, const char *regexp, unsigned int regexpSize){
+static unsigned int regexpPost(unsigned int post[], unsigned int postSize, const char *regexpIn, unsigned int regexpSize, unsigned int stack[], char pad[]){
     /*  parenthese  */
     unsigned int pn = 0;
 
-    unsigned int stack[regexpSize];
     unsigned int top = 0;
 
+    /*  '\0' around the RegExp for looking behind and ahead  */
+    memset(pad, 0, regexpSize + 5);
+    memcpy(pad + 1, regexpIn, regexpSize);
+    const char *regexp = pad + 1;
+
     unsigned int rn = 0;
     unsigned int v = 0;
     unsigned int concat = 0;
     int charWidth = 1;
-    while(regexp[rn] && pn<postSize){
+    while(rn < regexpSize && pn<postSize){
         switch(regexp[rn]){
             case '(':
-                if(concat)stack[top++] = CONCAT;
-                stack[top++] = LPAREN;
+                if(concat){
+                    /*  x*(y)   =>  (x*)---(y)  */
+                    while(top && stack[top-1]>CONCAT)
+                        post[pn++] = stack[--top];
+                    stack[top++] = CONCAT;
+                }
+                stack[top++] = LPAREN;
                 rn++;
                 concat = 0;
                 continue;
@@ -248,7 +1498,8 @@ static unsigned int regexpPost(unsigned int post[], unsigned int postSize, const
                 while(top && stack[top-1]>LPAREN)
                     post[pn++] = stack[--top];
                 post[pn++] = EXTRACT;
-                top--;
+                /*  pop LPAREN  */
+                if(top)top--;
                 rn++;
                 break;
             case '|':
@@ -293,6 +1544,11 @@ static unsigned int regexpPost(unsigned int post[], unsigned int postSize, const
                 post[pn++] = regexp[rn++] | METACHAR;
                 break;
             case ESCAPE_CHAR:
+                if(concat){
+                    while(top && stack[top-1]>CONCAT)
+                        post[pn++] = stack[--top];
+                    stack[top++] = CONCAT;
+                }
                 if(regexp[rn+1]=='x'
                         && (v=escx1[regexp[rn+2]&0x7f]
                             + escx0[regexp[rn+3]&0x7f])
@@ -304,16 +1560,13 @@ static unsigned int regexpPost(unsigned int post[], unsigned int postSize, const
                     /*  \d, \w ...  */
                     post[pn++] = regexp[++rn] | METACHAR;
                     ++rn;
-                }else{
+                }else if(rn+1 < regexpSize){
                     /*  \\, \* ...  */
-                    post[pn++] = regexp[++rn];
+                    post[pn++] = (unsigned char)regexp[++rn];
                     ++rn;
-                }
-                if(concat){
-                    while(top && stack[top-1]>CONCAT)
-                        post[pn++] = stack[--top];
-                    stack[top++] = CONCAT;
-                }
+                }else
+                    /*  trailing backslash  */
+                    post[pn++] = (unsigned char)regexp[rn++];
                 break;
             default:
                 if(concat){
@@ -321,14 +1574,15 @@ static unsigned int regexpPost(unsigned int post[], unsigned int postSize, const
                         post[pn++] = stack[--top];
                     stack[top++] = CONCAT;
                 }
-                charWidth = mblen(regexp+rn, CHARW_MAX);
+                charWidth = utf8Width(regexp+rn, regexpSize-rn);
                 /*  \x20\xE7\xBE\x9F*\x20   ('---' = concat)
                  *  =>  \x20---(\xE7---\xBE---\x9f)*---\x20
                  */ 
-                if((v=charWidth)>1){
-                    while(v--) post[pn++] = regexp[rn++];
+                if(charWidth>1){
+                    v = charWidth;
+                    while(v--) post[pn++] = (unsigned char)regexp[rn++];
                     while(--charWidth) post[pn++] = CONCAT;
-                }else post[pn++] = regexp[rn++];
+                }else post[pn++] = (unsigned char)regexp[rn++];
         }
         concat = 1;
     }
@@ -337,27 +1591,219 @@ static unsigned int regexpPost(unsigned int post[], unsigned int postSize, const
 }
 
 
+/*  Append src[] to dst[], keep the first LITERAL_MAX
+ *  bytes, or the last ones if tail.
+ *  @return int Length of dst[]
+ */
+static int literalCat(unsigned char dst[], int dstLen, const unsigned char src[], int srcLen, int tail){
+    if(tail && dstLen + srcLen > LITERAL_MAX){
+        int drop = dstLen + srcLen - LITERAL_MAX;
+        if(drop >= dstLen){
+            memcpy(dst, src + drop - dstLen, LITERAL_MAX);
+            return LITERAL_MAX;
+        }
+        memmove(dst, dst + drop, dstLen - drop);
+        dstLen -= drop;
+    }
+    if(dstLen + srcLen > LITERAL_MAX)srcLen = LITERAL_MAX - dstLen;
+    memcpy(dst + dstLen, src, srcLen);
+    return dstLen + srcLen;
+}
+
+/*  Literals of a concatenation, stored in a.   */
+static void literalConcat(struct FAliteral *a, const struct FAliteral *b){
+    struct FAliteral r;
+    unsigned char join[LITERAL_MAX];
+    int joinLen;
+    r.exactLen = -1;
+    if(a->exactLen >= 0 && b->exactLen >= 0
+            && a->exactLen + b->exactLen <= LITERAL_MAX)
+        r.exactLen = literalCat(memcpy(r.exact, a->exact, a->exactLen), a->exactLen, b->exact, b->exactLen, 0);
+    r.prefixLen = a->prefixLen;
+    memcpy(r.prefix, a->prefix, a->prefixLen);
+    if(a->exactLen >= 0)
+        r.prefixLen = literalCat(r.prefix, r.prefixLen, b->prefix, b->prefixLen, 0);
+    r.suffixLen = b->suffixLen;
+    memcpy(r.suffix, b->suffix, b->suffixLen);
+    if(b->exactLen >= 0)
+        r.suffixLen = literalCat(memcpy(r.suffix, a->suffix, a->suffixLen), a->suffixLen, b->exact, b->exactLen, 1);
+    /*  the longest of a, b and a's suffix with b's prefix  */
+    joinLen = literalCat(memcpy(join, a->suffix, a->suffixLen), a->suffixLen, b->prefix, b->prefixLen, 0);
+    r.factorLen = joinLen;
+    memcpy(r.factor, join, joinLen);
+    if(a->factorLen > r.factorLen){
+        r.factorLen = a->factorLen;
+        memcpy(r.factor, a->factor, a->factorLen);
+    }
+    if(b->factorLen > r.factorLen){
+        r.factorLen = b->factorLen;
+        memcpy(r.factor, b->factor, b->factorLen);
+    }
+    *a = r;
+}
+
+/*  Literals of an alternation, stored in a.    */
+static void literalUnion(struct FAliteral *a, const struct FAliteral *b){
+    int n = 0;
+    if(a->exactLen != b->exactLen
+            || memcmp(a->exact, b->exact, a->exactLen > 0? a->exactLen: 0))
+        a->exactLen = -1;
+    while(n < a->prefixLen && n < b->prefixLen
+            && a->prefix[n] == b->prefix[n])n++;
+    a->prefixLen = n;
+    n = 0;
+    while(n < a->suffixLen && n < b->suffixLen
+            && a->suffix[a->suffixLen-n-1] == b->suffix[b->suffixLen-n-1])n++;
+    memmove(a->suffix, a->suffix + a->suffixLen - n, n);
+    a->suffixLen = n;
+    a->factorLen = a->prefixLen;
+    memcpy(a->factor, a->prefix, a->prefixLen);
+    if(a->suffixLen > a->factorLen){
+        a->factorLen = a->suffixLen;
+        memcpy(a->factor, a->suffix, a->suffixLen);
+    }
+}
+
+/*  Find literal strings every match must contain.
+ *  @param  post    Array of postfix expression
+ *  @param  postLen Length of post[]
+ *  @param  lit     Literals of the whole expression
+ *  @return int     0, or <0 for malformed expression.
+ */
+static int regexpLiteral(struct regexpArena *arena, const unsigned int post[], unsigned int postLen, struct FAliteral *lit){
+    /*  a set of patterns makes a long post[]  */
+    struct FAliteral *stack = arenaAlloc(arena, sizeof(struct FAliteral)*(postLen+1));
+    int top = 0;
+    if(!stack)return(-1);
+    for(unsigned int m = 0; top >= 0 && m<postLen; m++){
+        switch(post[m]){
+            case EXTRACT:
+                if(top < 1)top = -1;
+                break;
+            case CLOSURE:
+                if(top < 1){
+                    top = -1;
+                    break;
+                }
+                memset(stack + top-1, 0, sizeof(struct FAliteral));
+                stack[top-1].exactLen = -1;
+                break;
+            case CONCAT:
+                if(top < 2){
+                    top = -1;
+                    break;
+                }
+                literalConcat(stack + top-2, stack + top-1);
+                top--;
+                break;
+            case UNION:
+                if(top < 2){
+                    top = -1;
+                    break;
+                }
+                literalUnion(stack + top-2, stack + top-1);
+                top--;
+                break;
+            default:
+                if(post[m] > OP_MIN && post[m] < PATTERN_TAG){
+                    top = -1;
+                    break;
+                }
+                memset(stack + top, 0, sizeof(struct FAliteral));
+                if(post[m] < 0x100){
+                    stack[top].exactLen = stack[top].prefixLen = 1;
+                    stack[top].suffixLen = stack[top].factorLen = 1;
+                    stack[top].exact[0] = stack[top].prefix[0] = post[m];
+                    stack[top].suffix[0] = stack[top].factor[0] = post[m];
+                }else
+                    /*  metachar, or epsilon and pattern tag
+                     *  which match "" only  */
+                    stack[top].exactLen = (post[m] == EPSILON
+                            || post[m] >= PATTERN_TAG)? 0: -1;
+                top++;
+        }
+    }
+    if(top == 1)*lit = stack[0];
+    arenaFree(arena, stack);
+    return (top == 1)? 0: -1;
+}
+
+static int groupKeyCmp(const void *ap, const void *bp){
+    long long a = *(const long long *)ap, b = *(const long long *)bp;
+    return (a > b) - (a < b);
+}
+
+/*  Number groups of a postfix expression by their '('.
+ *  The postfix of a group starts where its '(' is, so
+ *  groups are ordered by the start of their postfix,
+ *  outer groups first.
+ *  @param  group   Array to store the group number at
+ *                  each EXTRACT of post[]
+ *  @return int     Number of groups
+ *                  <0  for no memory.
+ */
+static int regexpGroups(struct regexpArena *arena, const unsigned int post[], unsigned int postSize, int group[]){
+    /*  start of each operand on the stack  */
+    unsigned int *first = arenaAlloc(arena, sizeof(int)*postSize);
+    long long *key = arenaAlloc(arena, sizeof(long long)*postSize);
+    if(!first || !key){
+        arenaFree(arena, key);
+        arenaFree(arena, first);
+        return(-1);
+    }
+    unsigned int top = 0;
+    int groups = 0;
+    for(unsigned int m = 0; m<postSize; m++){
+        switch(post[m]){
+            case UNION:
+            case CONCAT:
+                top--;
+                break;
+            case CLOSURE:
+                break;
+            case EXTRACT:
+                key[groups++] = (long long)first[top-1]*(postSize+1) + (postSize - m);
+                break;
+            default:
+                first[top++] = m;
+        }
+    }
+    qsort(key, groups, sizeof(long long), groupKeyCmp);
+    for(int g = 0; g<groups; g++)
+        group[postSize - key[g]%(postSize+1)] = g + 1;
+    arenaFree(arena, key);
+    arenaFree(arena, first);
+    return groups;
+}
+
 /*  Convert postfix expression to NFA transition function.
  *
  *  @param  nfaDelta        Array to store NFA moves
  *  @param  nfaDeltaSize    Allocated size of nfaDelta[]
  *  @param  post            Array of postfix expression
  *  @param  postSize        Length of post[]
+ *  @param  groups          Number of groups, NULL for
+ *                          no tagged moves around them
  *  @return int         Number of moves in nfaDelta[]
+ *                      <0  for no memory.
  */
-static int regexpPostNfa(struct FAdelta nfaDelta[], unsigned int nfaDeltaSize, unsigned int *post, unsigned int postSize){
-    /*  stack of before state   */
-    unsigned int stBf[nfaDeltaSize];
-    /*  stack of after state    */
-    unsigned int stAf[nfaDeltaSize];
+static int regexpPostNfa(struct regexpArena *arena, struct FAdelta nfaDelta[], unsigned int nfaDeltaSize, unsigned int *post, unsigned int postSize, int *groups){
+    /*  stack of before state, then of after state  */
+    unsigned int *stBf = arenaAlloc(arena, sizeof(int)*(nfaDeltaSize*2 + postSize));
+    if(!stBf)return(-1);
+    unsigned int *stAf = stBf + nfaDeltaSize;
+    /*  group number at each EXTRACT    */
+    int *group = (int *)(stAf + nfaDeltaSize);
+    if(groups && (*groups = regexpGroups(arena, post, postSize, group)) < 0){
+        arenaFree(arena, stBf);
+        return(-1);
+    }
     /*  top ptr for stBf, stAf  */
     unsigned int top = 0;
     /*  new NFA delta to create */
     unsigned int newDelta = 0;
     /*  available NFA node label    */
     unsigned int label = 0;
-    /*  submatch parenthese label   */
-    unsigned int npn = 0;
 
     stAf[top] = label++;    stBf[top] = label++;    top++;
 
@@ -404,26 +1850,43 @@ static int regexpPostNfa(struct FAdelta nfaDelta[], unsigned int nfaDeltaSize, u
                 label++;
                 break;
             case EXTRACT:
+                if(!groups)break;
+                /*  [x]->[y]    =>
+                 *  [x]-(open)->[z]->[w]-(close)->[y]
+                 *  tagged Epsilon-moves around the group
+                 */
                 nfaDelta[newDelta++] = (struct FAdelta){
                     .before = stBf[top-1],
+                        .after = label,
+                        .input = EPSILON,
+                        .nparen = -GROUP_OPEN(group[m])
+                };
+                nfaDelta[newDelta++] = (struct FAdelta){
+                    .before = label + 1,
                         .after = stAf[top-1],
-                        .input = EXTRACT_FLAG,
-                        .nparen = ++npn
+                        .input = EPSILON,
+                        .nparen = -GROUP_CLOSE(group[m])
                 };
+                stBf[top-1] = label;
+                stAf[top-1] = label + 1;
+                label += 2;
                 break;
             default:
                 /*  [x]->[y]    =>
                  *  [x]--(input)-->[y]
+                 *  a pattern tag is an Epsilon-move
+                 *  keeping the pattern number.
                  */
                 nfaDelta[newDelta++] = (struct FAdelta){
                     .before = stBf[top-1],
                         .after = stAf[top-1],
-                        .input = post[m],
-                        .nparen = 0
+                        .input = (post[m] < PATTERN_TAG)? post[m]: EPSILON,
+                        .nparen = (post[m] < PATTERN_TAG)? 0: post[m]-PATTERN_TAG+1
                 };
                 top--;
         }
     }
+    arenaFree(arena, stBf);
     return newDelta;
 }
 
@@ -432,8 +1895,8 @@ static int regexpPostNfa(struct FAdelta nfaDelta[], unsigned int nfaDeltaSize, u
  */
 static void indexNfaDeltas(struct FAdelta **nfaDeltaRef, int nfaDeltaLen, struct FAdelta **index[], int indexSize){
     int i = 0;
+    for(int n = 0; n < indexSize; n++)index[n] = NULL;
     index[i] = nfaDeltaRef + i;
-    while(i<nfaDeltaLen && nfaDeltaRef[i]->input == EXTRACT_FLAG)i++;
     index[nfaDeltaRef[i]->before] = nfaDeltaRef + i;
     for(i++; i<nfaDeltaLen; i++){
         if(nfaDeltaRef[i]->before != nfaDeltaRef[i-1]->before)
@@ -442,13 +1905,14 @@ static void indexNfaDeltas(struct FAdelta **nfaDeltaRef, int nfaDeltaLen, struct
     index[indexSize] = nfaDeltaRef + i;
 }
 
+/*  Index moves of every DFA state, states without
+ *  moves get an empty range.
+ */
 static void indexDfaDeltas(struct FAdelta **dfaDeltaRef, int dfaDeltaLen, struct FAdelta **index[], int indexSize){
     int i = 0;
-    while(dfaDeltaRef[i]->input == EXTRACT_FLAG)i++;
-    index[dfaDeltaRef[i]->before] = dfaDeltaRef + i;
-    while(++i<dfaDeltaLen){
-        if(dfaDeltaRef[i]->before != dfaDeltaRef[i-1]->before)
-            index[dfaDeltaRef[i]->before] = dfaDeltaRef + i;
+    for(int label = 0; label<indexSize; label++){
+        while(i<dfaDeltaLen && dfaDeltaRef[i]->before < label)i++;
+        index[label] = dfaDeltaRef + i;
     }
     index[indexSize] = dfaDeltaRef + dfaDeltaLen;
 }
@@ -457,50 +1921,146 @@ static int isCharType(int metachar, char c){
     if(metachar & METACHAR){
         switch(metachar & 0xff){
             case '.': return 1;
-            case 'd': return isdigit(c);
-            case 'D': return !isdigit(c);
-            case 'w': return isalnum(c)||c=='_';
-            case 'W': return !(isalnum(c)||c=='_');
-            case 's': return isspace(c);
-            case 'S': return !isspace(c);
+            case 'd': return IS_CHAR(CHAR_DIGIT, c);
+            case 'D': return !IS_CHAR(CHAR_DIGIT, c);
+            case 'w': return IS_CHAR(CHAR_WORD, c);
+            case 'W': return !IS_CHAR(CHAR_WORD, c);
+            case 's': return IS_CHAR(CHAR_SPACE, c);
+            case 'S': return !IS_CHAR(CHAR_SPACE, c);
+            case 'l': return IS_CHAR(CHAR_WORD, c) && !IS_CHAR(CHAR_DIGIT, c);
+            case 'p': return !IS_CHAR(CHAR_WORD | CHAR_SPACE, c);
+            case 'o': return !IS_CHAR(CHAR_WORD | CHAR_SPACE, c) && !utf8Atom(c);
+            case 'c':
+            case '2':
+            case '3':
+            case '4': return utf8Atom(c) == (metachar & 0xff);
+        }
+    }
+    return 0;
+}
+
+/*  Hash index of int sets, DFA subsets and search sets.
+ *  Sets are kept by the caller and numbered as added,
+ *  the index keeps their hashes only.
+ *  bucket: First set of each bucket, -1 for none
+ *  mask:   Number of buckets - 1
+ *  next:   Next set of the same bucket
+ *  hash:   Hash of each set
+ *  len:    Number of sets
+ *  size:   Allocated size of next[] and hash[]
+ *  arena:  Memory of the index, NULL for the heap
+ */
+struct setIndex{
+    int *bucket;
+    unsigned int mask;
+    int *next;
+    unsigned int *hash;
+    int len;
+    int size;
+    struct regexpArena *arena;
+};
+
+static unsigned int setHash(const int set[], int setSize){
+    unsigned int hash = 2166136261u;
+    for(int i = 0; i<setSize; i++)
+        hash = (hash ^ (unsigned int)set[i]) * 16777619u;
+    return hash ^ hash >> 15;
+}
+
+/*  First set of the bucket of hash, follow next[]  */
+static int setIndexFirst(const struct setIndex *index, unsigned int hash){
+    return index->bucket? index->bucket[hash & index->mask]: -1;
+}
+
+/*  Add set number index->len with its hash, the buckets
+ *  double when there are more sets than buckets.
+ *  @return int 0, or <0 for no memory.
+ */
+static int setIndexAdd(struct setIndex *index, unsigned int hash){
+    if(index->len == index->size){
+        int size = index->size? index->size*2: 64;
+        int *next = arenaRealloc(index->arena, index->next, sizeof(int)*size);
+        if(next)index->next = next;
+        unsigned int *hashes = arenaRealloc(index->arena, index->hash, sizeof(int)*size);
+        if(hashes)index->hash = hashes;
+        if(!next || !hashes)return(-1);
+        index->size = size;
+    }
+    if(!index->bucket || (unsigned int)index->len > index->mask){
+        unsigned int mask = index->bucket? index->mask*2+1: 63;
+        int *bucket = arenaAlloc(index->arena, sizeof(int)*(mask+1));
+        if(!bucket)return(-1);
+        for(unsigned int b = 0; b<=mask; b++)bucket[b] = -1;
+        for(int n = index->len; n--;){
+            index->next[n] = bucket[index->hash[n] & mask];
+            bucket[index->hash[n] & mask] = n;
         }
+        arenaFree(index->arena, index->bucket);
+        index->bucket = bucket;
+        index->mask = mask;
     }
+    index->hash[index->len] = hash;
+    index->next[index->len] = index->bucket[hash & index->mask];
+    index->bucket[hash & index->mask] = index->len++;
     return 0;
 }
 
-/*  Find subset name by set elements.
+static void setIndexFree(struct setIndex *index){
+    arenaFree(index->arena, index->hash);
+    arenaFree(index->arena, index->next);
+    arenaFree(index->arena, index->bucket);
+}
+
+static int intCmp(const void *ap, const void *bp){
+    int a = *(const int *)ap;
+    int b = *(const int *)bp;
+    return (a > b) - (a < b);
+}
+
+/*  Sort a set and drop repeated elements.
+ *  @return int Size of the set
+ */
+static int sub_canonSet(int set[], int setSize){
+    int n = 0;
+    qsort(set, setSize, sizeof(int), intCmp);
+    for(int i = 0; i<setSize; i++)
+        if(!n || set[n-1] != set[i])set[n++] = set[i];
+    return n;
+}
+
+/*  Find subset name by set elements, or add it to index
+ *  as subset dfaLabelSize.
+ *  @param  newSubset   Sorted and not repeated elements
  *  @return int Subset index
+ *              NO_MEMORY   for no memory.
  */
-static int sub_findSubset(int *dfaLabel[], int dfaLabelSize, int newSubset[], int newSubsetSize){
-    for(int label = 0; label<dfaLabelSize; label++){
-        if((dfaLabel[label+1] - dfaLabel[label]) != newSubsetSize)
+static int sub_findSubset(struct setIndex *index, int *dfaLabel[], int dfaLabelSize, int newSubset[], int newSubsetSize){
+    unsigned int hash = setHash(newSubset, newSubsetSize);
+    for(int label = setIndexFirst(index, hash); label >= 0; label = index->next[label]){
+        if(index->hash[label] != hash
+                || (dfaLabel[label+1] - dfaLabel[label]) != newSubsetSize)
             continue;
-        if(memcmp(dfaLabel[label], newSubset, newSubsetSize)==0)
+        if(memcmp(dfaLabel[label], newSubset, newSubsetSize * sizeof(int))==0)
             return label;
     }
+    if(setIndexAdd(index, hash) < 0)return(NO_MEMORY);
     return dfaLabelSize;
 }
 
-/*  Find DFA state label which has the
- *  nfa state label as an subset element.
- *  Search start from dfaN to dfaLabelLen.
- */
-static int nfaLabelDfaLabel(int nfaLabel, int dfaN, int *dfaLabel[], int dfaLabelLen){
-    for(int ld = dfaN; ld < dfaLabelLen; ld++)
-        for(int ln = 0; dfaLabel[ld] + ln < dfaLabel[ld+1]; ln++)
-            if(dfaLabel[ld][ln] == nfaLabel)return ld;
-    return dfaLabelLen;
-}
-
 /*  Insert subset of nfa states which are
  *  the next state of a certain input
  *  and a certain prev state.
  *
  *  @param  index   Cursor of NFA moves, and index of sorted
  *                  pointers array of pointers of NFA moves.
+ *  @param  subsetEnd   End of the subset elements storage
+ *  @param  subsetIndex Hash index of the subsets
  *  @return int Size of inserted subsets.
+ *              NO_SPACE    for no enough space for the new
+ *                          subset,
+ *              NO_MEMORY   for no memory.
  */
-static int sub_afterSubset(int *index, struct FAdelta *nfaDelta[], int nfaDeltaSize, int *dfaLabel[], int *labelSize){
+static int sub_afterSubset(int *index, struct FAdelta *nfaDelta[], int nfaDeltaSize, int *dfaLabel[], int *labelSize, int *subsetEnd, struct setIndex *subsetIndex){
     /*  newSubsetSize:            |<-       ->|
      *  subset:   |1|2|3|4|5|6|7|8| | | | | | | | | | | | | |
      *  dfaLabel   0 1   2 3 ..... ^labelSize  ^newSize
@@ -510,6 +2070,7 @@ static int sub_afterSubset(int *index, struct FAdelta *nfaDelta[], int nfaDeltaS
     int newSubsetSize = 0;
     int subset;
     int first = *index;
+    if(dfaLabel[*labelSize] + nfaDeltaSize > subsetEnd)return(NO_SPACE);
     dfaLabel[newSize] = dfaLabel[*labelSize];
     struct FAdelta *currDelta;
     if(!(nfaDelta[first]->input & METACHAR)){
@@ -520,17 +2081,26 @@ static int sub_afterSubset(int *index, struct FAdelta *nfaDelta[], int nfaDeltaS
                     = nfaDelta[n]->after;
             }
         }
+    }else{
+        /*  metachars matching all bytes of this one    */
+        int atoms = metaAtoms(nfaDelta[first]->input);
+        for(int n = 0; atoms && n < nfaDeltaSize
+                && nfaDelta[n]->input & METACHAR; n++){
+            if(nfaDelta[n]->input != nfaDelta[first]->input
+                    && !(atoms & ~metaAtoms(nfaDelta[n]->input)))
+                dfaLabel[newSize][newSubsetSize++]
+                    = nfaDelta[n]->after;
+        }
     }
-    for(currDelta = nfaDelta[first];
-            *index < nfaDeltaSize
-            && currDelta->input == nfaDelta[first]->input;
-            currDelta = nfaDelta[++(*index)]){ 
-        if(currDelta->input == EXTRACT_FLAG)continue;
+    for(; *index < nfaDeltaSize
+            && (currDelta = nfaDelta[*index])->input
+            == nfaDelta[first]->input; ++(*index)){
         dfaLabel[newSize][newSubsetSize++] = currDelta->after;
     }
+    newSubsetSize = sub_canonSet(dfaLabel[*labelSize], newSubsetSize);
     dfaLabel[newSize] += newSubsetSize;
-    if((subset = sub_findSubset(dfaLabel, *labelSize, dfaLabel[*labelSize], newSubsetSize)) < *labelSize)
-        /*  subset already exist    */
+    if((subset = sub_findSubset(subsetIndex, dfaLabel, *labelSize, dfaLabel[*labelSize], newSubsetSize)) < *labelSize)
+        /*  subset already exist, or no memory  */
         return subset;
     else{
         *labelSize = newSize;
@@ -547,133 +2117,566 @@ static int nfaCmpInput(const void *ap, const void *bp){
     return(b->input - a->input)?(b->input - a->input):(a->after-b->after);
 }
 
+/*  Split moves of metachars partly overlapping each other
+ *  into moves of disjoint atoms, \d, letter 'l', \s and the
+ *  rest 'p', so a byte takes the moves of every metachar
+ *  matching it, and a metachar matching all bytes of
+ *  another joins its moves in sub_afterSubset().
+ *  '.' on a lead byte another move takes, or a character
+ *  pending in the subset, splits them into all atoms of
+ *  metaAtoms() instead, as the lazy DFA takes bytes: '.'
+ *  goes on a lead byte to LAZY_UTF8() of its next state,
+ *  the character pending, which goes on a continuation
+ *  byte and is cut by any other byte, taken by the moves
+ *  of the state '.' goes to.
+ *  @param  cut     Moves from nfaSubset[cut] on are of the
+ *                  states pending characters are cut into,
+ *                  they take no continuation byte
+ *  @param  pending Pending characters of the subset
+ *  @param  len     Number of NFA states
+ *  @param  split   Set to moves from the arena sorted by
+ *                  nfaCmpInput(), NULL for no overlap
+ *  @return int Number of moves in split[]
+ *              <0  for no memory.
+ */
+static int sub_splitMetachar(struct regexpArena *arena, struct FAdelta *nfaSubset[], int nfaSubsetSize, int cut, const int pending[], int pendingLen, int len, struct FAdelta ***split){
+    static const char atomInput[] = {'d', 'l', 's', 'o', 'c', '2', '3', '4'};
+    int inputs = 0;
+    int overlap = 0;
+    /*  '.' and a lead byte another move takes  */
+    int any = 0;
+    int lead = 0;
+    *split = NULL;
+    for(int i = 0; i<nfaSubsetSize; i++){
+        const int input = nfaSubset[i]->input;
+        const int atoms = metaAtoms(input);
+        inputs |= 1 << ((atoms & 7) | ((atoms & ATOMS_OTHER)? 8: 0));
+        if(input == ('.' | METACHAR))any = 1;
+        else if(atoms? (atoms & (32|64|128)) != 0
+                : (input & 0xff) >= 0xc2 && (input & 0xff) <= 0xf4)
+            lead = 1;
+    }
+    for(int a = 1; a<16; a++)
+        for(int b = 1; b<16; b++)
+            if((inputs >> a & 1) && (inputs >> b & 1)
+                    && (a & b) && (a & ~b) && (b & ~a))
+                overlap = 1;
+    const int utf8 = pendingLen || (any && lead);
+    if(!overlap && !utf8)return 0;
+
+    /*  pointers, then the atom moves they point to */
+    const int maxLen = nfaSubsetSize*8 + pendingLen;
+    struct FAdelta **moves = arenaAlloc(arena, (sizeof(struct FAdelta *)
+                + sizeof(struct FAdelta))*maxLen);
+    if(!moves)return(-1);
+    struct FAdelta *atomDelta = (struct FAdelta *)(moves + maxLen);
+    int n = 0;
+    for(int i = 0; i<nfaSubsetSize; i++){
+        const int input = nfaSubset[i]->input;
+        const int atoms = metaAtoms(input);
+        if(!atoms && !(i >= cut && utf8Atom(input & 0xff) == 'c'))
+            moves[n++] = nfaSubset[i];
+        for(int a = 0; a < (utf8? 8: 4); a++){
+            if(!(atoms >> a & 1) || (i >= cut && atomInput[a] == 'c'))continue;
+            *atomDelta = *nfaSubset[i];
+            atomDelta->input = ((utf8 || a < 3)? atomInput[a]: 'p') | METACHAR;
+            if(input == ('.' | METACHAR) && a > 4)
+                /*  2, 3 or 4 bytes character   */
+                atomDelta->after = LAZY_UTF8(len, atomDelta->after, a - 4);
+            moves[n++] = atomDelta++;
+        }
+    }
+    for(int i = 0; i<pendingLen; i++){
+        /*  the last continuation byte ends it  */
+        *atomDelta = (struct FAdelta){ .input = 'c' | METACHAR, .after = pending[i] - len };
+        moves[n++] = atomDelta++;
+    }
+    qsort(moves, n, sizeof(struct FAdelta *), nfaCmpInput);
+    *split = moves;
+    return n;
+}
+
+/*  Sparse set of NFA states, adding, testing and
+ *  emptying take O(1), for epsilon-closures.
+ *  dense:  States as added
+ *  sparse: Position of each NFA state in dense[]
+ */
+struct sparseSet{
+    int *dense;
+    int *sparse;
+    int len;
+};
+
+/*  Add a state to a sparse set.
+ *  @return int 1 if added, 0 if it is in the set
+ */
+static int sparseAdd(struct sparseSet *set, int el){
+    int i = set->sparse[el];
+    if(i < set->len && set->dense[i] == el)return 0;
+    set->sparse[el] = set->len;
+    set->dense[set->len++] = el;
+    return 1;
+}
+
 /*  Add next state for active(incomplete) DFA state(subset).
-*/
-static void sub_insDfaDelta(int label, int *dfaLabel[], int *labelSize, struct FAdelta **nfaDeltaIndex[], int nfaDeltaIndexLen, struct FAdelta **newDfaDelta, int labelStates[]){
+ *  @param  closure Sparse sets of the NFA states, emptied
+ *                  and used for the epsilon-closures of the
+ *                  subset and of the states its pending
+ *                  characters are cut into
+ *  @param  accepts Bitmap to store patterns the state
+ *                  accepts, or NULL
+ *  @return int 0,
+ *              NO_SPACE    for no enough space for DFA
+ *                          moves or subsets, moves of the
+ *                          state are added again once
+ *                          they grow,
+ *              NO_MEMORY   for no memory.
+ */
+static int sub_insDfaDelta(struct regexpArena *arena, int label, int *dfaLabel[], int *labelSize, struct FAdelta **nfaDeltaIndex[], int nfaDeltaIndexLen, struct FAdelta **newDfaDelta, struct FAdelta *dfaDeltaEnd, int *subsetEnd, struct setIndex *subsetIndex, struct sparseSet closure[2], int labelStates[], unsigned int accepts[]){
     /*  prepare */
     int nfaSubsetSize = 0;
-    int subsetEl[nfaDeltaIndexLen];
-    int subsetElLen = 0;
+    /*  moves of closure[0], then of closure[1]  */
+    int cut = 0;
+    /*  LAZY_UTF8() of '.' are greater than NFA states,
+     *  and last in the sorted subset   */
+    const int *pending = dfaLabel[label+1];
+    closure[0].len = closure[1].len = 0;
     /*  copy subset element */
     for(int subset = 0; dfaLabel[label] + subset < dfaLabel[label+1]; subset++){
-        if(dfaLabel[label][subset] == FINAL_STATE){
+        int el = dfaLabel[label][subset];
+        if(el == FINAL_STATE){
             labelStates[label] |= FINAL;
             continue;
         }
-        subsetEl[subsetElLen++] = dfaLabel[label][subset];
+        if(el < nfaDeltaIndexLen){
+            sparseAdd(&closure[0], el);
+            continue;
+        }
+        /*  a character accepts as the state '.' goes to,
+         *  as it may be cut there  */
+        if(pending == dfaLabel[label+1])pending = dfaLabel[label] + subset;
+        if(el % nfaDeltaIndexLen == FINAL_STATE)labelStates[label] |= FINAL;
+        else sparseAdd(&closure[1], el % nfaDeltaIndexLen);
     }
+    const int pendingLen = dfaLabel[label+1] - pending;
     /*  Epsilon-closure, and,
-     *  calculate NFA moves related to this DFA state.
+     *  count NFA moves but Epsilon-moves of this DFA state.
      */
-    for(int ElIter = 0; ElIter < subsetElLen; ElIter++){
-        if(nfaDeltaIndex[subsetEl[ElIter]] == NULL)
-            continue;
-        nfaSubsetSize
-            += nfaDeltaIndex[subsetEl[ElIter]+1]
-            - nfaDeltaIndex[subsetEl[ElIter]];
-        for(int n=0; nfaDeltaIndex[subsetEl[ElIter]] + n
-                < nfaDeltaIndex[subsetEl[ElIter]+1]
-                && nfaDeltaIndex[subsetEl[ElIter]][n]->input
-                == EPSILON; n++){
-            subsetEl[subsetElLen++] = nfaDeltaIndex[subsetEl[ElIter]][n]->after;
-            if(nfaDeltaIndex[subsetEl[ElIter]][n]->after == FINAL_STATE)labelStates[label] |= FINAL;
+    for(int c = 0; c<2; c++){
+        int *subsetEl = closure[c].dense;
+        if(c)cut = nfaSubsetSize;
+        for(int ElIter = 0; ElIter < closure[c].len; ElIter++){
+            if(subsetEl[ElIter] == FINAL_STATE
+                    || subsetEl[ElIter] >= nfaDeltaIndexLen
+                    || nfaDeltaIndex[subsetEl[ElIter]] == NULL)
+                continue;
+            nfaSubsetSize
+                += nfaDeltaIndex[subsetEl[ElIter]+1]
+                - nfaDeltaIndex[subsetEl[ElIter]];
+            for(int n=0; nfaDeltaIndex[subsetEl[ElIter]] + n
+                    < nfaDeltaIndex[subsetEl[ElIter]+1]
+                    && nfaDeltaIndex[subsetEl[ElIter]][n]->input
+                    == EPSILON; n++){
+                int el = nfaDeltaIndex[subsetEl[ElIter]][n]->after;
+                nfaSubsetSize--;
+                sparseAdd(&closure[c], el);
+                if(el != FINAL_STATE)continue;
+                labelStates[label] |= FINAL;
+                /*  pattern tag */
+                int tag = nfaDeltaIndex[subsetEl[ElIter]][n]->nparen;
+                if(accepts && tag > 0)
+                    accepts[(tag-1)/32] |= 1u << ((tag-1)%32);
+            }
         }
     }
-    if(nfaSubsetSize == 0)return;
+    if(nfaSubsetSize + pendingLen == 0)return 0;
 
-    struct FAdelta *nfaSubset[nfaSubsetSize];
+    struct FAdelta **nfaSubset = arenaAlloc(arena, sizeof(struct FAdelta *)*nfaSubsetSize);
+    if(!nfaSubset)return(NO_MEMORY);
     int currSubsetSize = 0;
     int copySize = 0;
-    for(int ElIter = subsetElLen; ElIter--;){
-        if(subsetEl[ElIter] == 0)continue;
-        copySize = nfaDeltaIndex[subsetEl[ElIter]+1]
-            - nfaDeltaIndex[subsetEl[ElIter]];
-        memcpy(nfaSubset+currSubsetSize
-                , nfaDeltaIndex[subsetEl[ElIter]]
-                , copySize * sizeof(struct FAdelta *));
-        currSubsetSize += copySize;
+    for(int c = 0; c<2; c++){
+        int *subsetEl = closure[c].dense;
+        for(int ElIter = closure[c].len; ElIter--;){
+            if(subsetEl[ElIter] == FINAL_STATE
+                    || subsetEl[ElIter] >= nfaDeltaIndexLen
+                    || nfaDeltaIndex[subsetEl[ElIter]] == NULL)continue;
+            /*  Epsilon-moves come first, and are done  */
+            struct FAdelta **el = nfaDeltaIndex[subsetEl[ElIter]];
+            while(el < nfaDeltaIndex[subsetEl[ElIter]+1] && (*el)->input == EPSILON)el++;
+            copySize = nfaDeltaIndex[subsetEl[ElIter]+1] - el;
+            memcpy(nfaSubset+currSubsetSize
+                    , el
+                    , copySize * sizeof(struct FAdelta *));
+            currSubsetSize += copySize;
+        }
     }
     /*  group(sort) by input    */
-    qsort(nfaSubset, nfaSubsetSize, sizeof(struct FAdelta *), nfaCmpInput);
+    qsort(nfaSubset, cut, sizeof(struct FAdelta *), nfaCmpInput);
+    struct FAdelta **split;
+    struct FAdelta **moves = nfaSubset;
+    int movesLen = sub_splitMetachar(arena, nfaSubset, nfaSubsetSize, cut, pending, pendingLen, nfaDeltaIndexLen, &split);
+    if(movesLen < 0){
+        arenaFree(arena, nfaSubset);
+        return(NO_MEMORY);
+    }
+    if(split)moves = split;
+    else movesLen = nfaSubsetSize;
     struct FAdelta *currDfaDelta;
     int nfaDeltaIter = 0;
+    int ret = 0;
     /*  for each input  */
-    while(nfaDeltaIter < nfaSubsetSize){
-        while(nfaSubset[nfaDeltaIter]->input == EPSILON)
+    while(nfaDeltaIter < movesLen){
+        while(nfaDeltaIter < movesLen
+                && moves[nfaDeltaIter]->input == EPSILON)
             nfaDeltaIter++;
+        if(nfaDeltaIter == movesLen)break;
+        if(*newDfaDelta == dfaDeltaEnd){
+            ret = NO_SPACE;
+            break;
+        }
         currDfaDelta = (*newDfaDelta)++;
         currDfaDelta->before = label;
-        currDfaDelta->input = nfaSubset[nfaDeltaIter]->input;
-        if(currDfaDelta->input == EXTRACT_FLAG){
-            currDfaDelta->after = 
-                currDfaDelta->nparen = nfaSubset[nfaDeltaIter]->nparen;
-        }
+        currDfaDelta->input = moves[nfaDeltaIter]->input;
         currDfaDelta->after
-            = sub_afterSubset(&nfaDeltaIter, nfaSubset, nfaSubsetSize, dfaLabel, labelSize);
+            = sub_afterSubset(&nfaDeltaIter, moves, movesLen, dfaLabel, labelSize, subsetEnd, subsetIndex);
+        if(currDfaDelta->after < 0){
+            ret = currDfaDelta->after;
+            break;
+        }
     }
+    arenaFree(arena, split);
+    arenaFree(arena, nfaSubset);
+    return ret;
 }
 
-/*  TODO:   Implement submatch extraction.
-*/
-static void regexpExtructIndex(int indexb[], int indexa[], int *dfaLabel[], int dfaLabelLen, struct FAdelta **nfaDeltaIndex[]){
-    for(int dlabel = 0; dlabel<dfaLabelLen; dlabel++){
-        indexa[dlabel] = 0;
-        indexb[dlabel] = 0;
-        for(int nlabeli = 0; nlabeli + dfaLabel[dlabel] < dfaLabel[dlabel+1]; nlabeli++){
-            for(int i = 0; nfaDeltaIndex[0]+i < nfaDeltaIndex[1]; i++){
-                if(dfaLabel[dlabel][nlabeli] == nfaDeltaIndex[0][i]->before)
-                    indexb[dlabel] = nfaDeltaIndex[0][i]->nparen;
-                if(dfaLabel[dlabel][nlabeli] == nfaDeltaIndex[0][i]->after)
-                    indexa[dlabel] = nfaDeltaIndex[0][i]->nparen;
+/*  Convert NFA to DFA.
+ *  Moves, states and subsets take room from the arena,
+ *  and grow as the subsets are found, up to maxMoves.
+ *  @param  dfaDelta    Set to the DFA moves
+ *  @param  maxMoves    Max number of DFA moves
+ *  @param  dfa         Gets number of states, FINAL of
+ *                      labelState, and acceptSet of the
+ *                      patterns for a set
+ *  @return int Number of moves in dfaDelta[]
+ *              NO_SPACE    for more than maxMoves moves,
+ *              NO_MEMORY   for no memory.
+ */
+static int regexpNfaDfa(struct regexpArena *arena, struct FAdelta **nfaDeltaIndex[], int nfaDeltaIndexLen, struct FAdelta **dfaDelta, int maxMoves, struct FAdfa *dfa){
+    const int acceptWords = SET_WORDS(dfa->patterns);
+    const int nfaMoves = nfaDeltaIndex[nfaDeltaIndexLen]-nfaDeltaIndex[1];
+    /*  every new subset comes with a new DFA move,
+     *  a subset holds at most as many NFA states as
+     *  the NFA moves of its previous subset.
+     */
+    int size = nfaDeltaIndexLen + 64;
+    if(size > maxMoves)size = maxMoves;
+    int subsetSize = size*4 + nfaMoves + 1;
+    struct FAdelta *delta = arenaAlloc(arena, sizeof(struct FAdelta)*size);
+    int *labelStates = arenaCalloc(arena, size+1, sizeof(int));
+    unsigned int *acceptSet = NULL;
+    int **subsetLabels = arenaAlloc(arena, sizeof(int *)*(size+2));
+    int *subsetElements = arenaAlloc(arena, sizeof(int)*subsetSize);
+    /*  of a subset and of its pending characters   */
+    int *closureDense = arenaAlloc(arena, sizeof(int)*(nfaDeltaIndexLen+1)*2);
+    int *closureSparse = arenaCalloc(arena, (nfaDeltaIndexLen+1)*2, sizeof(int));
+    struct sparseSet closure[2] = {
+        { .dense = closureDense, .sparse = closureSparse },
+        { .dense = closureDense + nfaDeltaIndexLen+1, .sparse = closureSparse + nfaDeltaIndexLen+1 } };
+    struct setIndex subsetIndex = {.arena = arena};
+    int subsetLen = 0;
+    if(delta && labelStates && subsetLabels && subsetElements
+            && closureDense && closureSparse
+            && setIndexAdd(&subsetIndex, setHash((int []){1}, 1)) == 0){
+        subsetElements[0] = 1;
+        subsetLabels[0] = subsetElements;
+        subsetLabels[1] = subsetElements + 1;
+        subsetLen = 1;
+    }
+    int acceptLen = 0;
+    int movesLen = subsetLen? 0: NO_MEMORY;
+    for(int i = 0; i<subsetLen; i++){
+        if(labelStates[i] & COMPLETE) continue;
+        if(acceptWords && i == acceptLen){
+            unsigned int *set = arenaRealloc(arena, acceptSet, sizeof(int)*acceptWords*subsetLen*2);
+            if(!set){
+                movesLen = NO_MEMORY;
+                break;
+            }
+            memset(set + acceptLen*acceptWords, 0, sizeof(int)*acceptWords*(subsetLen*2 - acceptLen));
+            acceptSet = set;
+            acceptLen = subsetLen*2;
+        }
+        struct FAdelta *currDfaDelta = delta + movesLen;
+        int ret = sub_insDfaDelta(arena, i, subsetLabels, &subsetLen, nfaDeltaIndex, nfaDeltaIndexLen, &currDfaDelta, delta + size, subsetElements + subsetSize, &subsetIndex, closure, labelStates, acceptWords? acceptSet + i*acceptWords: NULL);
+        if(ret == NO_SPACE && size < maxMoves){
+            /*  grow and do this state again    */
+            int newSize = (size > maxMoves/2)? maxMoves: size*2;
+            int newSubsetSize = newSize*4 + nfaMoves + 1;
+            struct FAdelta *newDelta = arenaRealloc(arena, delta, sizeof(struct FAdelta)*newSize);
+            if(newDelta)delta = newDelta;
+            int *newStates = arenaRealloc(arena, labelStates, sizeof(int)*(newSize+1));
+            if(newStates)labelStates = newStates;
+            int **newLabels = arenaRealloc(arena, subsetLabels, sizeof(int *)*(newSize+2));
+            if(newLabels)subsetLabels = newLabels;
+            int *newElements = arenaRealloc(arena, subsetElements, sizeof(int)*newSubsetSize);
+            if(!newDelta || !newStates || !newLabels || !newElements){
+                movesLen = NO_MEMORY;
+                break;
             }
+            memset(labelStates + size+1, 0, sizeof(int)*(newSize - size));
+            for(int l = 0; l <= subsetLen; l++)
+                subsetLabels[l] = newElements + (subsetLabels[l] - subsetElements);
+            subsetElements = newElements;
+            subsetSize = newSubsetSize;
+            size = newSize;
+            i--;
+            continue;
+        }
+        if(ret < 0){
+            movesLen = ret;
+            break;
         }
+        movesLen = currDfaDelta - delta;
+        labelStates[i] |= COMPLETE;
     }
+
+    setIndexFree(&subsetIndex);
+    arenaFree(arena, closureSparse);
+    arenaFree(arena, closureDense);
+    arenaFree(arena, subsetElements);
+    arenaFree(arena, subsetLabels);
+    *dfaDelta = delta;
+    dfa->len = subsetLen;
+    dfa->labelState = labelStates;
+    dfa->acceptSet = acceptSet;
+    return movesLen;
 }
 
-/*  Convert NFA to DFA.
- *  @return int Number of moves in dfaDelta[]
+#ifndef LIMREGEX_NO_MINIMIZE
+/*  A move into a state, grouped by input to split
+ *  blocks of states by regexpDfaMin().  */
+struct minMove{
+    int input;
+    int state;
+};
+
+static int minMoveCmp(const void *ap, const void *bp){
+    const struct minMove *a = ap;
+    const struct minMove *b = bp;
+    return (a->input > b->input) - (a->input < b->input);
+}
+
+/*  Blocks of states for regexpDfaMin(), states of block b
+ *  are elem[first[b]] ... elem[end[b]-1], the marked ones
+ *  come first up to elem[mid[b]-1].
+ */
+struct minPartition{
+    int *elem;
+    int *loc;
+    int *block;
+    int *first;
+    int *mid;
+    int *end;
+    int len;
+    int *touched;
+    int touchedLen;
+    int *work;
+    int workLen;
+};
+
+static void minMark(struct minPartition *part, int state){
+    int b = part->block[state];
+    int i = part->loc[state];
+    int m = part->mid[b];
+    if(i < m)return;
+    if(m == part->first[b])part->touched[part->touchedLen++] = b;
+    part->elem[i] = part->elem[m];
+    part->loc[part->elem[i]] = i;
+    part->elem[m] = state;
+    part->loc[state] = m;
+    part->mid[b]++;
+}
+
+/*  Split every touched block into its marked and
+ *  unmarked states, the smaller part is a new block
+ *  and a splitter of its own.  */
+static void minSplit(struct minPartition *part, int addWork){
+    while(part->touchedLen){
+        int b = part->touched[--part->touchedLen];
+        int m = part->mid[b];
+        part->mid[b] = part->first[b];
+        if(m == part->end[b])continue;
+        int nb = part->len++;
+        if(m - part->first[b] <= part->end[b] - m){
+            part->first[nb] = part->first[b];
+            part->end[nb] = m;
+            part->first[b] = m;
+        }else{
+            part->first[nb] = m;
+            part->end[nb] = part->end[b];
+            part->end[b] = m;
+        }
+        part->mid[b] = part->first[b];
+        part->mid[nb] = part->first[nb];
+        for(int i = part->first[nb]; i < part->end[nb]; i++)
+            part->block[part->elem[i]] = nb;
+        /*  b is a splitter yet or it was done, either way
+         *  nb is enough    */
+        if(addWork)part->work[part->workLen++] = nb;
+    }
+}
+
+/*  Mark states of each run of moves[] of the same input,
+ *  then split by them. */
+static void minSplitBy(struct minPartition *part, struct minMove moves[], int movesLen, int addWork){
+    qsort(moves, movesLen, sizeof(struct minMove), minMoveCmp);
+    for(int i = 0; i<movesLen;){
+        int input = moves[i].input;
+        for(; i<movesLen && moves[i].input == input; i++)
+            minMark(part, moves[i].state);
+        minSplit(part, addWork);
+    }
+}
+
+/*  Minimize a DFA by Hopcroft's partition refinement.
+ *  States are equal unless their accepting or patterns
+ *  differ, or a move of an input tells them apart, a
+ *  missing move goes to the dead state. Moves of the
+ *  same input are alike, since sortDfa() orders the
+ *  moves of a state by input.
+ *  State 0 stays the initial state, moves of merged
+ *  states are dropped from dfaDelta[].
+ *  @param  dfaDeltaLen Number of moves in dfaDelta[]
+ *  @param  dfaLabelLen Number of DFA states, updated
+ *  @param  acceptSet   Bitmaps of patterns each DFA state
+ *                      accepts, acceptWords words a state,
+ *                      none if acceptWords is 0
+ *  @return int Number of moves left in dfaDelta[]
+ *              NO_MEMORY   for no memory.
  */
-static int regexpNfaDfa(struct FAdelta **nfaDeltaIndex[], int nfaDeltaIndexLen, struct FAdelta dfaDelta[], int dfaDeltaLen, int subsetLabelStates[], int extructIndexa[], int extructIndexb[]){
-    /*  XXX: appropriate subsetSize */
-    int subsetSize = nfaDeltaIndex[nfaDeltaIndexLen]-nfaDeltaIndex[1];
-    int subsetElements[subsetSize];
-    int *subsetLabels[subsetSize];
+static int regexpDfaMin(struct regexpArena *arena, struct FAdelta dfaDelta[], int dfaDeltaLen, int labelStates[], int *dfaLabelLen, unsigned int acceptSet[], int acceptWords){
+    const int len = *dfaLabelLen;
+    int *mem = arenaAlloc(arena, sizeof(int)*(len*9 + 2 + dfaDeltaLen));
+    struct minMove *moves = arenaAlloc(arena, sizeof(struct minMove)*(dfaDeltaLen + len*(acceptWords*32 + 1)));
+    if(!mem || !moves){
+        arenaFree(arena, moves);
+        arenaFree(arena, mem);
+        return(NO_MEMORY);
+    }
+    struct minPartition part = {
+        .elem = mem, .loc = mem + len, .block = mem + len*2,
+        .first = mem + len*3, .mid = mem + len*4, .end = mem + len*5,
+        .touched = mem + len*6, .work = mem + len*7, .len = 1 };
+    /*  moves into each state, by after */
+    int *inStart = mem + len*8;
+    int *in = inStart + len+2;
+    for(int l = 0; l<len; l++){
+        part.elem[l] = l;
+        part.loc[l] = l;
+        part.block[l] = 0;
+    }
+    part.first[0] = 0;
+    part.mid[0] = 0;
+    part.end[0] = len;
+
+    /*  initial blocks: accepting, then each pattern */
+    int movesLen = 0;
+    for(int l = 0; l<len; l++){
+        if(labelStates[l] & FINAL)
+            moves[movesLen++] = (struct minMove){ .input = -1, .state = l };
+        for(int p = 0; p < acceptWords*32; p++)
+            if(acceptSet[l*acceptWords + p/32] >> (p%32) & 1)
+                moves[movesLen++] = (struct minMove){ .input = p, .state = l };
+    }
+    minSplitBy(&part, moves, movesLen, 0);
+    for(int b = 0; b<part.len; b++)part.work[part.workLen++] = b;
+
+    for(int l = 0; l<len+2; l++)inStart[l] = 0;
+    for(int i = 0; i<dfaDeltaLen; i++)
+        inStart[dfaDelta[i].after+2]++;
+    for(int l = 0; l<len; l++)inStart[l+2] += inStart[l+1];
+    for(int i = 0; i<dfaDeltaLen; i++)
+        in[inStart[dfaDelta[i].after+1]++] = i;
 
-    subsetElements[0] = 1;
-    subsetLabels[0] = subsetElements;
-    subsetLabels[1] = subsetElements + 1;
-    subsetLabelStates[0] = ACTIVE;
-    int subsetLen = 1;
-    struct FAdelta *currDfaDelta = dfaDelta;
-    for(int i = 0; i<subsetLen
-            && currDfaDelta-dfaDelta < dfaDeltaLen; i++){
-        if(subsetLabelStates[i] & COMPLETE) continue;
-        sub_insDfaDelta(i, subsetLabels, &subsetLen, nfaDeltaIndex, nfaDeltaIndexLen, &currDfaDelta, subsetLabelStates);
-        subsetLabelStates[i] |= COMPLETE;
+    while(part.workLen){
+        int b = part.work[--part.workLen];
+        movesLen = 0;
+        for(int e = part.first[b]; e < part.end[b]; e++){
+            int l = part.elem[e];
+            for(int i = inStart[l]; i < inStart[l+1]; i++)
+                moves[movesLen++] = (struct minMove){
+                    .input = dfaDelta[in[i]].input, .state = dfaDelta[in[i]].before };
+        }
+        minSplitBy(&part, moves, movesLen, 1);
     }
 
-    regexpExtructIndex(extructIndexa, extructIndexb, subsetLabels, subsetLen, nfaDeltaIndex);
-    return (currDfaDelta - dfaDelta);
+    /*  number blocks by their first state, the
+     *  first state is the one left of a block  */
+    int *label = part.mid;
+    int *first = part.touched;
+    for(int b = 0; b<part.len; b++)label[b] = -1;
+    int labels = 0;
+    for(int l = 0; l<len; l++){
+        int b = part.block[l];
+        if(label[b] >= 0)continue;
+        first[labels] = l;
+        label[b] = labels++;
+    }
+    for(int l = 0; l<labels; l++){
+        labelStates[l] = labelStates[first[l]];
+        if(acceptWords)
+            memmove(acceptSet + l*acceptWords, acceptSet + first[l]*acceptWords, sizeof(int)*acceptWords);
+    }
+    int n = 0;
+    for(int i = 0; i<dfaDeltaLen; i++){
+        int l = label[part.block[dfaDelta[i].before]];
+        if(first[l] != dfaDelta[i].before)continue;
+        dfaDelta[n] = dfaDelta[i];
+        dfaDelta[n].before = l;
+        dfaDelta[n].after = label[part.block[dfaDelta[i].after]];
+        n++;
+    }
+    *dfaLabelLen = labels;
+    arenaFree(arena, moves);
+    arenaFree(arena, mem);
+    return n;
 }
+#endif
 
 /*  Compile DFA to VM instructions.
 */
-static int regexpDfaCl(struct FAdelta **dfaDeltaIndex[], int dfaDeltaIndexLen, int dfaLabelState[], int instr[], int instrLen){
+static int regexpDfaCl(const struct FAdfa *dfa, int instr[], int instrLen){
+    struct FAdelta ***dfaDeltaIndex = dfa->index;
+    int dfaDeltaIndexLen = dfa->len;
+    int *dfaLabelState = dfa->labelState;
     int dfaDeltaLen = dfaDeltaIndex[dfaDeltaIndexLen] - dfaDeltaIndex[0];
     struct FAdelta **deltaRef = dfaDeltaIndex[0];
-    int labelAddr[dfaDeltaIndexLen+1];
-    for(int n = 0; n<dfaDeltaIndexLen+1; n++)labelAddr[n] = 0;
+    /*  address of each state, then where each move
+     *  jumps from  */
+    int *labelAddr = arenaCalloc(dfa->arena, dfaDeltaIndexLen+1 + dfaDeltaLen, sizeof(int));
+    if(!labelAddr)return(-1);
+    int *jumpAddr = labelAddr + dfaDeltaIndexLen+1;
     int n = 0;
     int initJmpPos = 0;
     int currLabel = -1;
+    if(instrLen < 4){
+        arenaFree(dfa->arena, labelAddr);
+        return(-1);
+    }
     initJmpPos = n;
     instr[n++] = JMP;
-    instr[n] = n + 4;
+    /*  skip ACCEPTM1 and FRWRD of initial state  */
+    instr[n] = VM_INIT + 1 + ((dfaLabelState[0] & FINAL) != 0);
     n++;
     instr[n++] = ACCEPT;
+    /*  FAIL, then the initial state at VM_INIT */
 
     for(int i = 0; i < dfaDeltaLen; i++){
-        if(n >= instrLen)return(-1);
+        if(n + 11 > instrLen){
+            arenaFree(dfa->arena, labelAddr);
+            return(-1);
+        }
 
         if(currLabel != deltaRef[i]->before){
             currLabel = deltaRef[i]->before;
@@ -707,81 +2710,2671 @@ static int regexpDfaCl(struct FAdelta **dfaDeltaIndex[], int dfaDeltaIndexLen, i
                 case 'W':
                     instr[n++] = JNWRD;
                     break;
+                /*  atoms of sub_splitMetachar(), skip
+                 *  the bytes of the other atom first   */
+                case 'l':
+                    instr[n++] = JDEG;
+                    instr[n] = n + 3;
+                    n++;
+                    instr[n++] = JWRD;
+                    break;
+                case 'p':
+                    instr[n++] = JSPC;
+                    instr[n] = n + 3;
+                    n++;
+                    instr[n++] = JNWRD;
+                    break;
+                case 'o':
+                    instr[n++] = JSPC;
+                    instr[n] = n + 6;
+                    n++;
+                    instr[n++] = JWRD;
+                    instr[n] = n + 4;
+                    n++;
+                    instr[n++] = JUTF8;
+                    instr[n++] = 0;
+                    break;
+                case 'c':
+                case '2':
+                case '3':
+                case '4':
+                    instr[n++] = JUTF8;
+                    instr[n++] = deltaRef[i]->input & 0xff;
+                    break;
             }
         }else{
             instr[n++] = JEQ;
             instr[n++] = deltaRef[i]->input & 0xff;
         }
-        deltaRef[i]->input = n++;
+        jumpAddr[i] = n++;
     }
     /*  fill in the jump-to address */
     for(int i = 0; i < dfaDeltaLen; i++){
-        instr[deltaRef[i]->input] = labelAddr[deltaRef[i]->after];
-        if(!instr[deltaRef[i]->input])
-            instr[deltaRef[i]->input] = initJmpPos + 2;
+        instr[jumpAddr[i]] = labelAddr[deltaRef[i]->after];
+        if(!instr[jumpAddr[i]])
+            instr[jumpAddr[i]] = initJmpPos + 2;
     }
     instr[n++] = FAIL;
+    arenaFree(dfa->arena, labelAddr);
     return n;
 }
 
-/*  Compile a Regular Expression.
- *  @param  regexVM     Array to store VM instructions
- *  @param  VMSize      Allocated size of regexVM[]
- *  @param  regexStr    RegExp string
- *  @return int     Number of instructions.
- *                  <0  for no enough space in regexVM[].
- *                  0   for regexpStr = "\0".
+/*  Split byte classes by bytes in[] and out of in[],
+ *  classes are numbered by their smallest byte.
+ *  @return int Number of classes
  */
-int limregexcl(int regexVM[], int VMSize, const char regexStr[]){
-    setlocale(LC_CTYPE, UTF_8);
-    int regexpStrLen = strlen(regexStr);
-    if(regexpStrLen == 0)return 0;
-    /*  XXX: appropriate size for postexp[]     */
-    unsigned int postexp[regexpStrLen*2+1];
-    unsigned int postLen = regexpPost(postexp, regexpStrLen*2+1, regexStr, regexpStrLen);
-
-    /*  XXX: appropriate size of nfaDeltas[]    */
-    struct FAdelta nfaDeltas[postLen];
-    unsigned int nfaDeltaLen = regexpPostNfa(nfaDeltas, postLen, postexp, postLen);
-
-    /*  sort NFA moves  */
-    struct FAdelta *nfaDeltasRef[nfaDeltaLen];
-    /*  sort array of pointers instead array of struct  */
-    for(unsigned int n=0; n<nfaDeltaLen; n++)
-        nfaDeltasRef[n] = nfaDeltas + n;
+static int sub_splitByteClass(int classMap[], const char in[]){
+    int newClass[512];
+    int classLen = 0;
+    for(int k = 0; k<512; k++)newClass[k] = -1;
+    for(int b = 0; b<256; b++){
+        int k = classMap[b]*2 + (in[b] != 0);
+        if(newClass[k] < 0)newClass[k] = classLen++;
+        classMap[b] = newClass[k];
+    }
+    return classLen;
+}
 
-    sortNfa(nfaDeltasRef, nfaDeltaLen);
+/*  Group bytes which every DFA move takes alike
+ *  into equivalence classes, '\0' is always class 0.
+ *  @param  utf8    Also split UTF-8 lead and continuation
+ *                  bytes, for '.' continuation rows.
+ *  @return int Number of classes
+ */
+static int regexpByteClass(struct FAdelta **dfaDeltaIndex[], int dfaDeltaIndexLen, int utf8, int classMap[]){
+    char in[256];
+    int classLen = 1;
+    for(int b = 0; b<256; b++)classMap[b] = 0;
+    memset(in, 0, sizeof(in));
+    in[0] = 1;
+    classLen = sub_splitByteClass(classMap, in);
+    for(struct FAdelta **d = dfaDeltaIndex[0]; d < dfaDeltaIndex[dfaDeltaIndexLen]; d++){
+        /*  moves are sorted by input, split once per input */
+        if(d > dfaDeltaIndex[0] && d[-1]->input == (*d)->input)continue;
+        for(int b = 0; b<256; b++)
+            in[b] = ((*d)->input & METACHAR)?
+                isCharType((*d)->input, (char)b) != 0
+                : ((*d)->input & 0xff) == b;
+        classLen = sub_splitByteClass(classMap, in);
+    }
+    if(utf8){
+        /*  continuation, 2, 3, 4 bytes lead    */
+        static const int range[][2] = {
+            {0x80, 0xc0}, {0xc2, 0xe0}, {0xe0, 0xf0}, {0xf0, 0xf5}
+        };
+        for(int r = 0; r<4; r++){
+            for(int b = 0; b<256; b++)
+                in[b] = b >= range[r][0] && b < range[r][1];
+            classLen = sub_splitByteClass(classMap, in);
+        }
+    }
+    return classLen;
+}
 
-    /*  index NFA prev moves    */
-    int nfaDeltasIndexLen = nfaDeltasRef[nfaDeltaLen-1]->before+1;
-    struct FAdelta **nfaDeltasIndex[nfaDeltasIndexLen+1];
-    indexNfaDeltas(nfaDeltasRef, nfaDeltaLen, nfaDeltasIndex, nfaDeltasIndexLen);
-
-    /*  nfa->dfa    */
-    /*  XXX: appropriate size for dfaDeltas[]   */
-    struct FAdelta dfaDeltas[postLen];
-    int dfaLabelStates[postLen];
-    int extructIndexa[postLen];
-    int extructIndexb[postLen];
-    /*  set all DFA state as ACTIVE */
-    memset(dfaLabelStates, 0, sizeof(int)*postLen);
-    memset(extructIndexa, 0, sizeof(int)*postLen);
-    memset(extructIndexb, 0, sizeof(int)*postLen);
-
-    int dfaDeltaLen = regexpNfaDfa(nfaDeltasIndex, nfaDeltasIndexLen, dfaDeltas, postLen, dfaLabelStates, extructIndexa, extructIndexb);
-
-    struct FAdelta *dfaDeltasRef[dfaDeltaLen];
-    /*  sort array of pointers instead array of struct  */
-    for(int n=0; n<dfaDeltaLen; n++)
-        dfaDeltasRef[n] = dfaDeltas + n;
+/*  Find search state by its set of rows, or add it.
+ *  @return int Search state index
+ *              <0  for no more search state.
+ */
+static int sub_findSearchSet(struct regexpArena *arena, struct setIndex *index, int **setEl, int *setElSize, int setStart[], int *setLen, int maxSets, int newSet[], int newSetSize){
+    unsigned int hash = setHash(newSet, newSetSize);
+    for(int n = setIndexFirst(index, hash); n >= 0; n = index->next[n]){
+        if(index->hash[n] != hash || setStart[n+1] - setStart[n] != newSetSize)
+            continue;
+        if(memcmp(*setEl + setStart[n], newSet, newSetSize * sizeof(int))==0)
+            return n;
+    }
+    if(*setLen == maxSets || setIndexAdd(index, hash) < 0)return(-1);
+    if(setStart[*setLen] + newSetSize > *setElSize){
+        int *el = arenaRealloc(arena, *setEl, sizeof(int)*(*setElSize*2 + newSetSize));
+        if(!el)return(-1);
+        *setEl = el;
+        *setElSize = *setElSize*2 + newSetSize;
+    }
+    memcpy(*setEl + setStart[*setLen], newSet, newSetSize * sizeof(int));
+    setStart[*setLen+1] = setStart[*setLen] + newSetSize;
+    return (*setLen)++;
+}
 
-    sortDfa(dfaDeltasRef, dfaDeltaLen);
-    int dfaDeltasIndexLen = dfaDeltasRef[dfaDeltaLen-1]->before+1;
-    struct FAdelta **dfaDeltasIndex[dfaDeltasIndexLen+1];
-    indexDfaDeltas(dfaDeltasRef, dfaDeltaLen, dfaDeltasIndex, dfaDeltasIndexLen);
+/*  Append unanchored search rows to a table.
+ *  A search state is the set of rows reached by at least
+ *  one byte from any position, the initial row joins
+ *  every move, so a search never dies and reaches an
+ *  accepting row at the end of the earliest match.
+ *  Also fills the set of bytes a match can begin with.
+ *  @param  rowAccept   Bitmaps of patterns each row
+ *                      accepts, words words a row, grown
+ *                      for search rows, none if words is 0
+ *  @return int Length of table[] used.
+ *              <0  for no enough space in table[].
+ */
+static int regexpTableSearch(struct regexpArena *arena, int table[], int tableLen, unsigned int **rowAccept, int words){
+    const int classLen = table[TBL_CLASSES];
+    const int rows = table[TBL_ROWS];
+    const int init = table[TBL_START];
+    const int accept = table[TBL_ACCEPT];
+    const unsigned char *map = (const unsigned char *)(table + TBL_CLASSMAP);
+    int *delta = table + TBL_DELTA;
+    int maxSets = (tableLen - TBL_DELTA)/classLen - rows;
+    if(maxSets < 1)return(-1);
+
+    /*  set n is setEl[setStart[n]] ... setEl[setStart[n+1]-1],
+     *  set 0 is the empty set, the initial search state */
+    int setElSize = rows;
+    int *newSet = arenaAlloc(arena, sizeof(int)*rows);
+    int *setStart = arenaAlloc(arena, sizeof(int)*(maxSets+1));
+    int *setNext = arenaAlloc(arena, sizeof(int)*maxSets*classLen);
+    int *setEl = arenaAlloc(arena, sizeof(int)*setElSize);
+    int setLen = 1;
+    int n = 0;
+    struct setIndex setIndex = {.arena = arena};
+    if(!newSet || !setEl || !setStart || !setNext || setIndexAdd(&setIndex, setHash(newSet, 0)) < 0)n = -1;
+    else setStart[0] = setStart[1] = 0;
+    for(; n>=0 && n<setLen; n++){
+        setNext[n*classLen] = 0;
+        for(int k = 1; k<classLen; k++){
+            int newSetSize = 0;
+            for(int i = setStart[n]; i <= setStart[n+1]; i++){
+                int next = delta[k + ((i < setStart[n+1])? setEl[i]: init)];
+                if(!next)continue;
+                /*  insert into sorted newSet[]  */
+                int j = newSetSize;
+                while(j && newSet[j-1] > next)j--;
+                if(j && newSet[j-1] == next)continue;
+                memmove(newSet+j+1, newSet+j, sizeof(int)*(newSetSize-j));
+                newSet[j] = next;
+                newSetSize++;
+            }
+            setNext[n*classLen + k] = sub_findSearchSet(arena, &setIndex, &setEl, &setElSize, setStart, &setLen, maxSets, newSet, newSetSize);
+            if(setNext[n*classLen + k] < 0){
+                n = -2;
+                break;
+            }
+        }
+    }
+    setIndexFree(&setIndex);
+    int *setRow = (n < 0)? NULL: arenaAlloc(arena, sizeof(int)*setLen);
+    if(!setRow){
+        arenaFree(arena, setEl);
+        arenaFree(arena, setNext);
+        arenaFree(arena, setStart);
+        arenaFree(arena, newSet);
+        return(-1);
+    }
+
+    /*  accepting search rows after all the others  */
+    int searchRows = rows;
+    for(int pass = 0; pass<2; pass++){
+        if(pass)table[TBL_SEARCH_ACCEPT] = searchRows*classLen;
+        for(n = 0; n<setLen; n++){
+            int final = 0;
+            for(int i = setStart[n]; i < setStart[n+1]; i++)
+                if(setEl[i] >= accept)final = 1;
+            if(final == pass)setRow[n] = classLen*searchRows++;
+        }
+    }
+    for(n = 0; n<setLen; n++)
+        for(int k = 0; k<classLen; k++)
+            delta[setRow[n] + k] = setRow[setNext[n*classLen + k]];
+
+    /*  a search row accepts patterns of all its rows   */
+    unsigned int *setAccept = words?
+        arenaRealloc(arena, *rowAccept, sizeof(int)*words*searchRows): NULL;
+    if(setAccept){
+        *rowAccept = setAccept;
+        memset(setAccept + rows*words, 0, sizeof(int)*words*(searchRows - rows));
+        for(n = 0; n<setLen; n++)
+            for(int i = setStart[n]; i < setStart[n+1]; i++){
+                if(setEl[i] < accept)continue;
+                for(int w = 0; w<words; w++)
+                    setAccept[setRow[n]/classLen*words + w]
+                        |= setAccept[setEl[i]/classLen*words + w];
+            }
+    }else if(words)n = -1;
+
+    unsigned int *first = (unsigned int *)(table + TBL_FIRSTBYTE);
+    memset(first, 0, 256/8);
+    for(int b = 0; b<256; b++)
+        if(delta[init + map[b]])
+            first[b>>5] |= 1u << (b&31);
+    table[TBL_SEARCH_START] = setRow[0];
+    table[TBL_ROWS] = searchRows;
+    arenaFree(arena, setRow);
+    arenaFree(arena, setEl);
+    arenaFree(arena, setNext);
+    arenaFree(arena, setStart);
+    arenaFree(arena, newSet);
+    return (n < 0)? -1: TBL_DELTA + searchRows*classLen;
+}
+
+/*  Append patterns each accepting row accepts to a table,
+ *  see TBL_PATTERN_SET.
+ *  @param  tableUsed   Length of table[] used
+ *  @param  rowAccept   Bitmaps of patterns of each row
+ *  @return int Length of table[] used.
+ *              <0  for no enough space in table[].
+ */
+static int regexpTableSets(int table[], int tableLen, int tableUsed, const unsigned int rowAccept[]){
+    const int classLen = table[TBL_CLASSES];
+    const int rows = table[TBL_ROWS];
+    const int words = SET_WORDS(table[TBL_PATTERNS]);
+    if(tableUsed + rows > tableLen)return(-1);
+    int *rowSet = table + tableUsed;
+    table[TBL_PATTERN_SET] = tableUsed;
+    tableUsed += rows;
+    for(int row = 0; row<rows; row++){
+        int offset = row*classLen;
+        rowSet[row] = 0;
+        /*  anchored or search accepting row    */
+        if((offset < table[TBL_ACCEPT] || offset >= table[TBL_SEARCH_START])
+                && offset < table[TBL_SEARCH_ACCEPT])
+            continue;
+        if(tableUsed + words > tableLen)return(-1);
+        memcpy(table + tableUsed, rowAccept + row*words, sizeof(int)*words);
+        rowSet[row] = tableUsed;
+        tableUsed += words;
+    }
+    return tableUsed;
+}
+
+/*  Append reverse rows to a table, to find where a match
+ *  found by regexpSearch() begins without trying every
+ *  byte before its end.
+ *  A reverse state is the set of anchored rows which go to
+ *  a row of the set it began with by the bytes read so far,
+ *  read backward, and accepts if the initial row is in it.
+ *  From the accepting rows it accepts at the start of a
+ *  match ending where it began, from all the rows but the
+ *  dead one at the start of a match alive there.
+ *  Too many reverse rows are not made, see
+ *  REVERSE_ROWS_MIN, the search tries every byte then.
+ *  @param  tableUsed   Length of table[] used
+ *  @return int Length of table[] used.
+ *              <0  for no enough space in table[], -n if
+ *                  n is enough.
+ */
+static int regexpTableReverse(struct regexpArena *arena, int table[], int tableLen, int tableUsed){
+    const int classLen = table[TBL_CLASSES];
+    const int rows = table[TBL_SEARCH_START]/classLen;
+    const int init = table[TBL_START]/classLen;
+    const int accept = table[TBL_ACCEPT]/classLen;
+    int *delta = table + TBL_DELTA;
+    /*  the empty set is the dead row 0    */
+    int maxSets = table[TBL_ROWS]*2 + REVERSE_ROWS_MIN + 1;
+    table[TBL_REVERSE_START] = table[TBL_REVERSE_LIVE] = table[TBL_REVERSE_ACCEPT] = 0;
 
-    int codeLen = regexpDfaCl(dfaDeltasIndex, dfaDeltasIndexLen, dfaLabelStates, regexVM, VMSize);
-    return codeLen;
+    /*  moves into row t are pred[predStart[t]] ...
+     *  pred[predStart[t+1]-1], as row*classLen + class  */
+    int *predStart = arenaCalloc(arena, rows+2, sizeof(int));
+    int *pred = arenaAlloc(arena, sizeof(int)*rows*classLen);
+    int *bucketStart = arenaAlloc(arena, sizeof(int)*(classLen+1));
+    int *bucket = arenaAlloc(arena, sizeof(int)*rows*classLen);
+    int *newSet = arenaAlloc(arena, sizeof(int)*rows);
+    int *setStart = arenaAlloc(arena, sizeof(int)*(maxSets+1));
+    int *setNext = arenaAlloc(arena, sizeof(int)*maxSets*classLen);
+    int setElSize = rows*2;
+    int *setEl = arenaAlloc(arena, sizeof(int)*setElSize);
+    int setLen = 1;
+    int n = 1;
+    int start = 0, live = 0;
+    struct setIndex setIndex = {.arena = arena};
+    if(!predStart || !pred || !bucketStart || !bucket || !newSet || !setStart || !setNext || !setEl
+            || setIndexAdd(&setIndex, setHash(newSet, 0)) < 0)
+        n = -1;
+    else{
+        setStart[0] = setStart[1] = 0;
+        for(int r = 1; r<rows; r++)
+            for(int k = 1; k<classLen; k++)
+                predStart[delta[r*classLen + k]/classLen + 2]++;
+        for(int t = 0; t<rows; t++)
+            predStart[t+2] += predStart[t+1];
+        for(int r = 1; r<rows; r++)
+            for(int k = 1; k<classLen; k++)
+                pred[predStart[delta[r*classLen + k]/classLen + 1]++] = r*classLen + k;
+        /*  from the accepting rows, then all rows  */
+        int newSetSize = 0;
+        for(int r = accept; r<rows; r++)newSet[newSetSize++] = r;
+        start = sub_findSearchSet(arena, &setIndex, &setEl, &setElSize, setStart, &setLen, maxSets, newSet, newSetSize);
+        newSetSize = 0;
+        for(int r = 1; r<rows; r++)newSet[newSetSize++] = r;
+        live = sub_findSearchSet(arena, &setIndex, &setEl, &setElSize, setStart, &setLen, maxSets, newSet, newSetSize);
+        if(start < 0 || live < 0)n = -1;
+    }
+    for(; n>=1 && n<setLen; n++){
+        /*  rows going to the set, by the class of the move */
+        memset(bucketStart, 0, sizeof(int)*(classLen+1));
+        for(int i = setStart[n]; i < setStart[n+1]; i++)
+            for(int p = predStart[setEl[i]]; p < predStart[setEl[i]+1]; p++)
+                bucketStart[pred[p]%classLen + 1]++;
+        for(int k = 0; k<classLen; k++)
+            bucketStart[k+1] += bucketStart[k];
+        for(int i = setStart[n]; i < setStart[n+1]; i++)
+            for(int p = predStart[setEl[i]]; p < predStart[setEl[i]+1]; p++)
+                bucket[bucketStart[pred[p]%classLen]++] = pred[p]/classLen;
+        setNext[n*classLen] = 0;
+        for(int k = 1, from = 0; k<classLen; k++){
+            int newSetSize = 0;
+            qsort(bucket + from, bucketStart[k] - from, sizeof(int), intCmp);
+            for(int i = from; i < bucketStart[k]; i++)
+                if(!newSetSize || newSet[newSetSize-1] != bucket[i])
+                    newSet[newSetSize++] = bucket[i];
+            from = bucketStart[k];
+            setNext[n*classLen + k] = sub_findSearchSet(arena, &setIndex, &setEl, &setElSize, setStart, &setLen, maxSets, newSet, newSetSize);
+            if(setNext[n*classLen + k] < 0){
+                n = -2;
+                break;
+            }
+        }
+    }
+    setIndexFree(&setIndex);
+    int *setRow = (n < 0)? NULL: arenaAlloc(arena, sizeof(int)*setLen);
+    if(setRow && tableUsed + (long long)(setLen-1)*classLen > tableLen){
+        arenaFree(arena, setRow);
+        setRow = NULL;
+        tableUsed = (tableUsed + (long long)(setLen-1)*classLen < INT_MAX)?
+            -(tableUsed + (setLen-1)*classLen): -1;
+    }
+    if(setRow){
+        /*  accepting reverse rows after all the others  */
+        int reverseRows = table[TBL_ROWS];
+        setRow[0] = 0;
+        for(int pass = 0; pass<2; pass++){
+            if(pass)table[TBL_REVERSE_ACCEPT] = reverseRows*classLen;
+            for(n = 1; n<setLen; n++){
+                int final = 0;
+                for(int i = setStart[n]; i < setStart[n+1]; i++)
+                    if(setEl[i] == init)final = 1;
+                if(final == pass)setRow[n] = classLen*reverseRows++;
+            }
+        }
+        for(n = 1; n<setLen; n++)
+            for(int k = 0; k<classLen; k++)
+                delta[setRow[n] + k] = setRow[setNext[n*classLen + k]];
+        table[TBL_REVERSE_START] = setRow[start];
+        table[TBL_REVERSE_LIVE] = setRow[live];
+        tableUsed += (reverseRows - table[TBL_ROWS])*classLen;
+        table[TBL_ROWS] = reverseRows;
+    }
+    arenaFree(arena, setRow);
+    arenaFree(arena, setEl);
+    arenaFree(arena, setNext);
+    arenaFree(arena, setStart);
+    arenaFree(arena, newSet);
+    arenaFree(arena, bucket);
+    arenaFree(arena, bucketStart);
+    arenaFree(arena, pred);
+    arenaFree(arena, predStart);
+    return tableUsed;
+}
+
+/*  Find rows staying on a large set of bytes, and
+ *  describe the set by byte ranges for regexpRun().
+ *  The kernel of a row is kept in column 0, which no
+ *  byte maps to, 0 for none.
+ */
+static void regexpTableKernel(int table[]){
+    const int classLen = table[TBL_CLASSES];
+    const unsigned char *map = (const unsigned char *)(table + TBL_CLASSMAP);
+    unsigned char *kernel = (unsigned char *)(table + TBL_KERNEL);
+    int *delta = table + TBL_DELTA;
+    int kernelLen = 0;
+    memset(kernel, 0, KERNEL_MAX*KERNEL_SIZE);
+    delta[0] = 0;
+    for(int row = classLen; row < table[TBL_ROWS]*classLen; row += classLen){
+        unsigned char range[KERNEL_SIZE];
+        int setSize = 0;
+        memset(range, 0, KERNEL_SIZE);
+        delta[row] = 0;
+        for(int b = 1; b<256; b++){
+            if(delta[row + map[b]] != row)continue;
+            setSize++;
+            if(range[0] && range[range[0]*2] == b-1)
+                range[range[0]*2] = b;
+            else if(range[0] == KERNEL_RANGES){
+                setSize = 0;
+                break;
+            }else{
+                range[range[0]*2+1] = range[range[0]*2+2] = b;
+                range[0]++;
+            }
+        }
+        if(setSize < KERNEL_MIN)continue;
+        int k = 0;
+        while(k < kernelLen && memcmp(kernel + k*KERNEL_SIZE, range, KERNEL_SIZE))k++;
+        if(k == KERNEL_MAX)continue;
+        if(k == kernelLen)
+            memcpy(kernel + kernelLen++*KERNEL_SIZE, range, KERNEL_SIZE);
+        delta[row] = k + 1;
+    }
+}
+
+/*  Compile DFA to a dense transition table.
+ *  Bytes are mapped to equivalence classes by the map at
+ *  table[TBL_CLASSMAP...], table[TBL_DELTA...] holds one
+ *  row of next states per DFA state and one column per
+ *  class, next states are stored as row offsets so that
+ *  a move costs one lookup.
+ *  Row 0 is the dead state, accepting rows are placed
+ *  after all the others, a state accepts if its offset
+ *  is not less than table[TBL_ACCEPT].
+ *  '.' on an UTF-8 lead byte goes through up to 3 extra
+ *  rows consuming the continuation bytes, as utf8Width().
+ *  Moves of a state are tried in the same order as VM.
+ *  @return int Length of table[] used.
+ *              <0  for no enough space in table[], -n if
+ *                  n is likely to be enough.
+ */
+static int regexpDfaTable(const struct FAdfa *dfa, int table[], int tableLen){
+    struct FAdelta ***dfaDeltaIndex = dfa->index;
+    int dfaDeltaIndexLen = dfa->len;
+    int *dfaLabelState = dfa->labelState;
+    const struct FAliteral *lit = &dfa->lit;
+    int *labelRow = arenaAlloc(dfa->arena, sizeof(int)*dfaDeltaIndexLen*2);
+    if(!labelRow)return(-1);
+    /*  first continuation row of '.' to a state   */
+    int *anyRow = labelRow + dfaDeltaIndexLen;
+    int rows = 1;
+    int utf8 = 0;
+    for(int l = 0; l<dfaDeltaIndexLen; l++){
+        anyRow[l] = 0;
+        if(!(dfaLabelState[l] & FINAL))labelRow[l] = rows++;
+    }
+    /*  continuation rows accept as the state '.' moves to,
+     *  the character may be cut there, else it moves on to
+     *  that state which accepts later  */
+    int acceptRow = 0;
+    for(int accepting = 0; accepting<2; accepting++){
+        acceptRow = rows;
+        for(struct FAdelta **d = dfaDeltaIndex[0]; d < dfaDeltaIndex[dfaDeltaIndexLen]; d++)
+            if((*d)->input == ('.' | METACHAR) && !anyRow[(*d)->after]
+                    && !(dfaLabelState[(*d)->after] & FINAL) == !accepting){
+                anyRow[(*d)->after] = rows;
+                rows += 3;
+                utf8 = 1;
+            }
+    }
+    for(int l = 0; l<dfaDeltaIndexLen; l++)
+        if(dfaLabelState[l] & FINAL)labelRow[l] = rows++;
+
+    int classMap[256];
+    /*  column 0 is for regexpTableKernel() */
+    int classLen = regexpByteClass(dfaDeltaIndex, dfaDeltaIndexLen, utf8, classMap) + 1;
+    for(int b = 0; b<256; b++)classMap[b]++;
+    /*  smallest byte of each class */
+    int classByte[classLen];
+    for(int b = 256; b--;)classByte[classMap[b]] = b;
+    if(TBL_DELTA + (long long)rows*classLen > tableLen){
+        arenaFree(dfa->arena, labelRow);
+        /*  about as many search rows and reverse rows
+         *  are to come   */
+        return (TBL_DELTA + (long long)rows*classLen*3 < INT_MAX)?
+            -(TBL_DELTA + rows*classLen*3): -1;
+    }
+
+    unsigned char *map = (unsigned char *)(table + TBL_CLASSMAP);
+    for(int b = 0; b<256; b++)map[b] = classMap[b];
+    int *delta = table + TBL_DELTA;
+    memset(delta, 0, sizeof(int)*rows*classLen);
+    for(int l = 0; l<dfaDeltaIndexLen; l++){
+        int *row = delta + labelRow[l]*classLen;
+        for(struct FAdelta **d = dfaDeltaIndex[l]; d < dfaDeltaIndex[l+1]; d++){
+            int next = labelRow[(*d)->after]*classLen;
+            if(!((*d)->input & METACHAR)){
+                if(!row[classMap[(*d)->input & 0xff]])
+                    row[classMap[(*d)->input & 0xff]] = next;
+                continue;
+            }
+            for(int k = 1; k<classLen; k++){
+                int b = classByte[k];
+                if(row[k] || !isCharType((*d)->input, (char)b))continue;
+                if((*d)->input == ('.' | METACHAR) && anyRow[(*d)->after] && b >= 0xc2 && b <= 0xf4)
+                    /*  2, 3 or 4 bytes character   */
+                    row[k] = (anyRow[(*d)->after]
+                            + (b >= 0xe0) + (b >= 0xf0))*classLen;
+                else row[k] = next;
+            }
+        }
+    }
+    /*  continuation bytes, an invalid one is taken
+     *  by the state '.' moves to   */
+    for(int l = 0; l<dfaDeltaIndexLen; l++){
+        if(!anyRow[l])continue;
+        int *row = delta + anyRow[l]*classLen;
+        for(int i = 0; i<3; i++, row += classLen)
+            for(int k = 1; k<classLen; k++)
+                row[k] = (classByte[k] >= 0x80 && classByte[k] < 0xc0)?
+                    (i? (anyRow[l]+i-1)*classLen: labelRow[l]*classLen)
+                    : delta[labelRow[l]*classLen + k];
+    }
+    table[TBL_ROWS] = rows;
+    table[TBL_START] = labelRow[0]*classLen;
+    table[TBL_ACCEPT] = acceptRow*classLen;
+    table[TBL_CLASSES] = classLen;
+    /*  prefix is enough unless factor is longer    */
+    unsigned char *literal = (unsigned char *)(table + TBL_LITERAL);
+    memset(literal, 0, LITERAL_MAX*2);
+    table[TBL_PREFIX_LEN] = lit->prefixLen;
+    memcpy(literal, lit->prefix, lit->prefixLen);
+    table[TBL_FACTOR_LEN] = (lit->factorLen > lit->prefixLen)? lit->factorLen: 0;
+    memcpy(literal + LITERAL_MAX, lit->factor, table[TBL_FACTOR_LEN]);
+    table[TBL_PATTERNS] = dfa->patterns;
+    table[TBL_PATTERN_SET] = 0;
+    table[TBL_REVERSE_START] = table[TBL_REVERSE_LIVE] = table[TBL_REVERSE_ACCEPT] = 0;
+
+    /*  patterns of anchored rows   */
+    int words = dfa->patterns? SET_WORDS(dfa->patterns): 0;
+    unsigned int *rowAccept = NULL;
+    if(words){
+        rowAccept = arenaCalloc(dfa->arena, rows*words, sizeof(int));
+        if(!rowAccept){
+            arenaFree(dfa->arena, labelRow);
+            return(-1);
+        }
+        for(int l = 0; l<dfaDeltaIndexLen; l++)
+            if(dfaLabelState[l] & FINAL){
+                memcpy(rowAccept + labelRow[l]*words, dfa->acceptSet + l*words, sizeof(int)*words);
+                for(int i = 0; anyRow[l] && i<3; i++)
+                    memcpy(rowAccept + (anyRow[l]+i)*words, dfa->acceptSet + l*words, sizeof(int)*words);
+            }
+    }
+    int tableUsed = regexpTableSearch(dfa->arena, table, tableLen, &rowAccept, words);
+    if(tableUsed > 0)regexpTableKernel(table);
+    if(tableUsed > 0 && words)
+        tableUsed = regexpTableSets(table, tableLen, tableUsed, rowAccept);
+    else if(tableUsed > 0)
+        tableUsed = regexpTableReverse(dfa->arena, table, tableLen, tableUsed);
+    arenaFree(dfa->arena, rowAccept);
+    arenaFree(dfa->arena, labelRow);
+    return tableUsed;
+}
+
+/*  Monotonic clock of compile stages.
+ *  @return long long   Nanoseconds
+ */
+static long long statsClock(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+/*  Length of RegExp string i, given or up to '\0'   */
+static size_t regexpLen(const char *regexStr[], const size_t regexLen[], int i){
+    return regexLen? regexLen[i]: strlen(regexStr[i]);
+}
+
+typedef int (*regexpBackend)(const struct FAdfa *, int[], int);
+
+/*  Build the NFA of RegExp strings.
+ *  @param  arena       Memory of the NFA, NULL for the heap
+ *  @param  nfa         NFA to build, regexpNfaFree() it
+ *                      once built
+ *  @param  regexStr    RegExp strings
+ *  @param  regexLen    Length of each RegExp string,
+ *                      or NULL for '\0' ended ones
+ *  @param  patterns    Number of RegExp strings as a set,
+ *                      0 for a single RegExp regexStr[0]
+ *  @param  tags        1 to tag moves around groups
+ *  @param  stats       Sizes and times of the stages,
+ *                      or NULL
+ *  @return int     1   built
+ *                  0   for regexpStr = "\0".
+ *                  <0  for no memory,
+ *                      MALFORMED for malformed RegExp.
+ */
+static int regexpNfa(struct regexpArena *arena, struct FAnfa *nfa, const char *regexStr[], const size_t regexLen[], int patterns, int tags, struct limregex_stats *stats){
+    if(!patterns && regexpLen(regexStr, regexLen, 0) == 0)return 0;
+    nfa->groups = 0;
+    /*  XXX: appropriate size for postexp[]
+     *  pattern n of a set is
+     *  pattern PATTERN_TAG+n CONCAT UNION  */
+    unsigned int postSize = 1;
+    size_t longest = 0;
+    for(int i = 0; i<patterns || i == 0; i++){
+        size_t len = regexpLen(regexStr, regexLen, i);
+        postSize += len*3+1 + 3;
+        if(len > longest)longest = len;
+    }
+    unsigned int *postexp = arenaAlloc(arena, sizeof(int)*postSize);
+    /*  operator stack and padded copy for regexpPost()  */
+    unsigned int *postStack = arenaAlloc(arena, sizeof(int)*longest + longest + 5);
+    if(!postexp || !postStack){
+        arenaFree(arena, postStack);
+        arenaFree(arena, postexp);
+        return(NO_MEMORY);
+    }
+    char *postPad = (char *)(postStack + longest);
+    unsigned int postLen = 0;
+    long long t = stats? statsClock(): 0;
+    if(!patterns)
+        postLen = regexpPost(postexp, postSize, regexStr[0], regexpLen(regexStr, regexLen, 0), postStack, postPad);
+    for(int i = 0; i<patterns; i++){
+        unsigned int len = (regexpLen(regexStr, regexLen, i) == 0)? 0:
+            regexpPost(postexp + postLen, postSize - postLen, regexStr[i], regexpLen(regexStr, regexLen, i), postStack, postPad);
+        if(len == 0)postexp[postLen + len++] = EPSILON;
+        postLen += len;
+        postexp[postLen++] = PATTERN_TAG + i;
+        postexp[postLen++] = CONCAT;
+        if(i)postexp[postLen++] = UNION;
+    }
+    arenaFree(arena, postStack);
+    if(stats){
+        stats->postLen = postLen;
+        stats->postNs = statsClock() - t;
+        t = statsClock();
+    }
+    if(postLen == 0){
+        arenaFree(arena, postexp);
+        return 0;
+    }
+    /*  also checks unbalanced parentheses  */
+    if(regexpLiteral(arena, postexp, postLen, &nfa->lit) < 0){
+        arenaFree(arena, postexp);
+        return(MALFORMED);
+    }
+
+    /*  a closure or a group adds 2 moves, others at
+     *  most 1, then the sorted pointers    */
+    nfa->deltas = arenaAlloc(arena, (sizeof(struct FAdelta) + sizeof(struct FAdelta *))*postLen*2);
+    int nfaDeltaLen = nfa->deltas?
+        regexpPostNfa(arena, nfa->deltas, postLen*2, postexp, postLen, tags? &nfa->groups: NULL): -1;
+    if(nfaDeltaLen < 0){
+        arenaFree(arena, nfa->deltas);
+        arenaFree(arena, postexp);
+        return(NO_MEMORY);
+    }
+
+    /*  sort array of pointers instead array of struct  */
+    nfa->ref = (struct FAdelta **)(nfa->deltas + postLen*2);
+    for(int n=0; n<nfaDeltaLen; n++)
+        nfa->ref[n] = nfa->deltas + n;
+    sortNfa(nfa->ref, nfaDeltaLen);
+
+    /*  index NFA prev moves    */
+    nfa->len = nfa->ref[nfaDeltaLen-1]->before+1;
+    nfa->index = arenaAlloc(arena, sizeof(struct FAdelta **)*(nfa->len+1));
+    if(!nfa->index){
+        arenaFree(arena, nfa->deltas);
+        arenaFree(arena, postexp);
+        return(NO_MEMORY);
+    }
+    indexNfaDeltas(nfa->ref, nfaDeltaLen, nfa->index, nfa->len);
+    arenaFree(arena, postexp);
+    if(stats){
+        stats->nfaStates = nfa->len;
+        stats->nfaMoves = nfaDeltaLen;
+        stats->nfaNs = statsClock() - t;
+    }
+    return 1;
+}
+
+static void regexpNfaFree(struct regexpArena *arena, struct FAnfa *nfa){
+    arenaFree(arena, nfa->index);
+    arenaFree(arena, nfa->deltas);
+}
+
+/*  Build the DFA of RegExp strings, all of it from the
+ *  arena and indexed for a backend.
+ *  @param  dfa         DFA to build
+ *  @param  regexStr    RegExp strings
+ *  @param  regexLen    Length of each RegExp string,
+ *                      or NULL for '\0' ended ones
+ *  @param  patterns    Number of RegExp strings as a set,
+ *                      0 for a single RegExp regexStr[0]
+ *  @param  maxMoves    Max number of DFA moves
+ *  @param  stats       Sizes and times of the stages,
+ *                      or NULL
+ *  @return int     1   built
+ *                  0   for regexpStr = "\0".
+ *                  NO_SPACE    for more than maxMoves,
+ *                  NO_MEMORY   for no memory,
+ *                  MALFORMED   for malformed RegExp.
+ */
+static int regexpDfa(struct regexpArena *arena, struct FAdfa *dfa, const char *regexStr[], const size_t regexLen[], int patterns, int maxMoves, struct limregex_stats *stats){
+    struct FAnfa nfa;
+    int built = regexpNfa(arena, &nfa, regexStr, regexLen, patterns, 0, stats);
+    if(built <= 0)return built;
+    *dfa = (struct FAdfa){.arena = arena, .patterns = patterns, .acceptSet = NULL, .lit = nfa.lit};
+
+    struct FAdelta *dfaDeltas;
+    if(maxMoves < 1)maxMoves = 1;
+    long long t = stats? statsClock(): 0;
+    int dfaDeltaLen = regexpNfaDfa(arena, nfa.index, nfa.len, &dfaDeltas, maxMoves, dfa);
+    regexpNfaFree(arena, &nfa);
+    dfa->subsets = dfa->len;
+    if(stats){
+        stats->dfaSubsets = dfa->subsets;
+        stats->dfaNs = statsClock() - t;
+        t = statsClock();
+    }
+#ifndef LIMREGEX_NO_MINIMIZE
+    if(dfaDeltaLen >= 0)
+        dfaDeltaLen = regexpDfaMin(arena, dfaDeltas, dfaDeltaLen, dfa->labelState, &dfa->len, dfa->acceptSet, SET_WORDS(patterns));
+#endif
+    if(dfaDeltaLen < 0)return dfaDeltaLen;
+    if(stats){
+        stats->dfaStates = dfa->len;
+        stats->dfaMoves = dfaDeltaLen;
+        stats->minNs = statsClock() - t;
+    }
+
+    /*  sort array of pointers instead array of struct  */
+    struct FAdelta **dfaDeltasRef = arenaAlloc(arena, sizeof(struct FAdelta *)*(dfaDeltaLen+1));
+    dfa->index = arenaAlloc(arena, sizeof(struct FAdelta **)*(dfa->len+1));
+    if(!dfaDeltasRef || !dfa->index)return(NO_MEMORY);
+    for(int n=0; n<dfaDeltaLen; n++)
+        dfaDeltasRef[n] = dfaDeltas + n;
+    sortDfa(dfaDeltasRef, dfaDeltaLen);
+    indexDfaDeltas(dfaDeltasRef, dfaDeltaLen, dfa->index, dfa->len);
+    return 1;
+}
+
+/*  Compile a Regular Expression with a backend.
+ *  @param  out         Array to store the compiled RegExp
+ *  @param  outSize     Allocated size of out[]
+ *  @param  regexStr    RegExp strings
+ *  @param  regexLen    Length of each RegExp string,
+ *                      or NULL for '\0' ended ones
+ *  @param  patterns    Number of RegExp strings as a set,
+ *                      0 for a single RegExp regexStr[0]
+ *  @param  backend     Converts the DFA to out[]
+ *  @param  dfaSize     Max number of DFA moves
+ *  @return int     Length of out[] used.
+ *                  <0  for no enough space in out[],
+ *                      MALFORMED for malformed RegExp.
+ *                  0   for regexpStr = "\0".
+ */
+static int regexpCompile(int out[], int outSize, const char *regexStr[], const size_t regexLen[], int patterns, regexpBackend backend, int dfaSize){
+    struct regexpArena arena = {0};
+    struct FAdfa dfa;
+    int outLen = regexpDfa(&arena, &dfa, regexStr, regexLen, patterns, dfaSize, NULL);
+    if(outLen > 0)outLen = backend(&dfa, out, outSize);
+    arenaDestroy(&arena);
+    return (outLen < 0 && outLen != MALFORMED)? -1: outLen;
+}
+
+/*  Compile a Regular Expression.
+ *  @param  regexVM     Array to store VM instructions
+ *  @param  VMSize      Allocated size of regexVM[]
+ *  @param  regexStr    RegExp string
+ *  @return int     Number of instructions.
+ *                  <0  for no enough space in regexVM[],
+ *                      MALFORMED for malformed RegExp.
+ *                  0   for regexpStr = "\0".
+ */
+int limregexcl(int regexVM[], int VMSize, const char regexStr[]){
+    /*  a DFA move takes at least 2 instructions    */
+    return regexpCompile(regexVM, VMSize, &regexStr, NULL, 0, regexpDfaCl, VMSize/2);
+}
+
+/*  Compile a Regular Expression in a buffer,
+ *  '\0' is a character.
+ *  @param  regexVM     Array to store VM instructions
+ *  @param  VMSize      Allocated size of regexVM[]
+ *  @param  regexBuf    RegExp
+ *  @param  regexLen    Length of regexBuf[]
+ *  @return int     Number of instructions.
+ *                  <0  for no enough space in regexVM[],
+ *                      MALFORMED for malformed RegExp.
+ *                  0   for regexLen = 0.
+ */
+int limregexcl_n(int regexVM[], int VMSize, const char regexBuf[], size_t regexLen){
+    return regexpCompile(regexVM, VMSize, &regexBuf, &regexLen, 0, regexpDfaCl, VMSize/2);
+}
+
+/*  Compile a Regular Expression to transition table.
+ *  @param  table       Array to store the table
+ *  @param  tableSize   Allocated size of table[]
+ *  @param  regexStr    RegExp string
+ *  @return int     Length of table[] used.
+ *                  <0  for no enough space in table[],
+ *                      MALFORMED for malformed RegExp.
+ *                  0   for regexpStr = "\0".
+ */
+int limregex_compile_table(int table[], int tableSize, const char regexStr[]){
+    /*  a DFA move takes at least a column  */
+    return regexpCompile(table, tableSize, &regexStr, NULL, 0, regexpDfaTable, tableSize/4);
+}
+
+/*  Compile a Regular Expression in a buffer to transition
+ *  table, '\0' is a character.
+ *  @param  table       Array to store the table
+ *  @param  tableSize   Allocated size of table[]
+ *  @param  regexBuf    RegExp
+ *  @param  regexLen    Length of regexBuf[]
+ *  @return int     Length of table[] used.
+ *                  <0  for no enough space in table[],
+ *                      MALFORMED for malformed RegExp.
+ *                  0   for regexLen = 0.
+ */
+int limregex_compile_table_n(int table[], int tableSize, const char regexBuf[], size_t regexLen){
+    return regexpCompile(table, tableSize, &regexBuf, &regexLen, 0, regexpDfaTable, tableSize/4);
+}
+
+/*  Compile a set of Regular Expressions to one table,
+ *  accepting rows keep the patterns they accept.
+ *  @param  patterns    RegExp strings
+ *  @param  n           Number of patterns
+ *  @param  table       Array to store the table
+ *  @param  tableSize   Allocated size of table[]
+ *  @return int     Length of table[] used.
+ *                  <0  for no enough space in table[],
+ *                      MALFORMED for malformed RegExp.
+ *                  0   for n < 1.
+ */
+int limregex_set_compile(const char *patterns[], int n, int table[], int tableSize){
+    if(n < 1)return 0;
+    return regexpCompile(table, tableSize, patterns, NULL, n, regexpDfaTable, tableSize/4);
+}
+
+/*  Compile a set of Regular Expressions in buffers to one
+ *  table, '\0' is a character.
+ *  @param  patterns    RegExp buffers
+ *  @param  lens        Length of each buffer, a pattern of
+ *                      length 0 matches ""
+ *  @param  n           Number of patterns
+ *  @param  table       Array to store the table
+ *  @param  tableSize   Allocated size of table[]
+ *  @return int     Length of table[] used.
+ *                  <0  for no enough space in table[],
+ *                      MALFORMED for malformed RegExp.
+ *                  0   for n < 1.
+ */
+int limregex_set_compile_n(const char *patterns[], const size_t lens[], int n, int table[], int tableSize){
+    if(n < 1)return 0;
+    return regexpCompile(table, tableSize, patterns, lens, n, regexpDfaTable, tableSize/4);
+}
+
+/*  Backend of limregex_dfa_states(), DFA state counts.
+ *  @return int 2
+ */
+static int regexpDfaStates(const struct FAdfa *dfa, int out[], int outLen){
+    if(outLen < 2)return(-1);
+    out[0] = dfa->subsets;
+    out[1] = dfa->len;
+    return 2;
+}
+
+/*  Count DFA states of a Regular Expression, as the
+ *  subset construction builds them and as minimized.
+ *  @param  states      states[0] before and states[1]
+ *                      after minimization, equal if it
+ *                      is built with LIMREGEX_NO_MINIMIZE
+ *  @param  maxMoves    Max number of DFA moves
+ *  @param  regexStr    RegExp string
+ *  @return int     2   counted
+ *                  <0  for more than maxMoves DFA moves,
+ *                      MALFORMED for malformed RegExp.
+ *                  0   for regexpStr = "\0".
+ */
+int limregex_dfa_states(int states[2], int maxMoves, const char regexStr[]){
+    return regexpCompile(states, 2, &regexStr, NULL, 0, regexpDfaStates, maxMoves);
+}
+
+/*  Compile context.
+ *  arena:      Memory of the compiles, reset by each
+ *  program:    Program last compiled, in the arena
+ *  programLen: Length of program[]
+ *  stats:      Stages of the last compile
+ */
+struct limregex_context{
+    struct regexpArena arena;
+    int *program;
+    int programLen;
+    struct limregex_stats stats;
+};
+
+/*  Make a compile context.
+ *  @param  allocator   Memory hook, NULL for malloc()
+ *  @return struct limregex_context*    NULL for no memory
+ */
+struct limregex_context *limregex_context_new(const struct limregex_allocator *allocator){
+    static const struct limregex_allocator heap = {0};
+    if(!allocator)allocator = &heap;
+    struct limregex_context *context = allocatorAlloc(allocator, sizeof(*context));
+    if(!context)return NULL;
+    *context = (struct limregex_context){ .arena = { .block = NULL, .allocator = *allocator } };
+    return context;
+}
+
+/*  Free a compile context.
+ *  @param  context limregex_context_new() made, or NULL
+ */
+void limregex_context_free(struct limregex_context *context){
+    if(!context)return;
+    struct limregex_allocator allocator = context->arena.allocator;
+    arenaDestroy(&context->arena);
+    allocatorFree(&allocator, context, sizeof(*context));
+}
+
+/*  Compile into the arena of a context. The DFA is built
+ *  once with no bound, the output starts at the size the
+ *  backend is likely to need and doubles until it fits.
+ *  @return int     Length of the program.
+ *                  <0  for no memory,
+ *                      MALFORMED for malformed RegExp.
+ *                  0   for regexpStr = "\0".
+ */
+static int regexpContextCompile(struct limregex_context *context, const char *regexStr[], const size_t regexLen[], int patterns, regexpBackend backend){
+    struct regexpArena *arena = &context->arena;
+    struct FAdfa dfa;
+    context->program = NULL;
+    context->programLen = 0;
+    context->stats = (struct limregex_stats){0};
+    arenaReset(arena);
+    int built = regexpDfa(arena, &dfa, regexStr, regexLen, patterns, INT_MAX/8, &context->stats);
+    if(built <= 0)return (built < 0 && built != MALFORMED)? -1: built;
+    long long t = statsClock();
+    /*  a state takes at most 3 instructions and a move 7,
+     *  a table tells its size without building search rows   */
+    size_t outSize = (backend == regexpDfaTable)? TBL_DELTA: TBL_DELTA + 64
+        + ((size_t)dfa.len + (dfa.index[dfa.len] - dfa.index[0]))*8;
+    while(outSize <= INT_MAX){
+        int *out = arenaAlloc(arena, sizeof(int)*outSize);
+        if(!out)break;
+        int outLen = backend(&dfa, out, outSize);
+        if(outLen > 0){
+            context->program = arenaRealloc(arena, out, sizeof(int)*outLen);
+            context->programLen = outLen;
+            context->stats.programLen = outLen;
+            context->stats.emitNs = statsClock() - t;
+            return outLen;
+        }
+        arenaFree(arena, out);
+        outSize = (outLen < -1 && (size_t)-outLen > outSize)?
+            (size_t)-outLen: outSize*2;
+    }
+    return(-1);
+}
+
+/*  Compile a Regular Expression in a buffer, '\0' is
+ *  a character, into a context. No recompile is needed
+ *  for any size, copy it by limregex_context_emit().
+ *  @param  context     limregex_context_new() made
+ *  @param  regexBuf    RegExp
+ *  @param  regexLen    Length of regexBuf[]
+ *  @param  kind        LIMREGEX_VM or LIMREGEX_TABLE
+ *  @return int     Exact length of the program.
+ *                  <0  for no memory,
+ *                      MALFORMED for malformed RegExp.
+ *                  0   for regexLen = 0.
+ */
+int limregex_context_compile(struct limregex_context *context, const char regexBuf[], size_t regexLen, int kind){
+    return regexpContextCompile(context, &regexBuf, &regexLen, 0,
+            (kind == LIMREGEX_VM)? regexpDfaCl: regexpDfaTable);
+}
+
+/*  Compile a set of Regular Expressions to one table
+ *  in a context, see limregex_set_compile().
+ *  @param  context     limregex_context_new() made
+ *  @param  patterns    RegExp strings
+ *  @param  n           Number of RegExp strings
+ *  @return int     Exact length of the table.
+ *                  <0  for no memory,
+ *                      MALFORMED for malformed RegExp.
+ *                  0   for n < 1.
+ */
+int limregex_context_set_compile(struct limregex_context *context, const char *patterns[], int n){
+    if(n < 1){
+        context->program = NULL;
+        context->programLen = 0;
+        context->stats = (struct limregex_stats){0};
+        return 0;
+    }
+    return regexpContextCompile(context, patterns, NULL, n, regexpDfaTable);
+}
+
+/*  Copy the program last compiled in a context.
+ *  @param  context     limregex_context_new() made
+ *  @param  out         Array to store the program
+ *  @param  outSize     Allocated size of out[]
+ *  @return int     Length of out[] used.
+ *                  <0  for no enough space in out[].
+ */
+int limregex_context_emit(const struct limregex_context *context, int out[], int outSize){
+    if(outSize < context->programLen)return(-1);
+    memcpy(out, context->program, sizeof(int)*context->programLen);
+    return context->programLen;
+}
+
+/*  Read the stages of the compile last done in a
+ *  context, sizes of the stages it reached, the others
+ *  are 0.
+ *  @param  context     limregex_context_new() made
+ *  @param  stats       Pointer to store the stages
+ */
+void limregex_context_stats(const struct limregex_context *context, struct limregex_stats *stats){
+    *stats = context->stats;
+}
+
+/*  Lazy DFA, DFA states are built from the NFA when the
+ *  input reaches them, in a cache of fixed size, which is
+ *  emptied when full. Not for more than one thread at once.
+ *  A DFA state is a sorted set of NFA states closed over
+ *  Epsilon-moves, and elements past the NFA states:
+ *  LAZY_UTF8(len, a, k) for k continuation bytes left of
+ *  a character '.' takes to NFA state a, LAZY_SEARCH(len)
+ *  for unanchored search, the initial state joins every
+ *  move. len is the number of NFA states.
+ *  nfa:        The NFA
+ *  utf8:       '.' takes a UTF-8 character
+ *  anyFinal:   1 for NFA states closed over FINAL_STATE,
+ *              LAZY_UTF8() of them accept as a character
+ *              may be cut there
+ *  map:        Class of each byte
+ *  classByte:  Smallest byte of each class
+ *  maxStates:  Size of the cache
+ *  row:        Next state of each state and class,
+ *              LAZY_UNKNOWN for not built yet
+ *  final:      1 for accepting states
+ *  setStart:   Set of state n is setEl[setStart[n]] ...
+ *              setEl[setStart[n+1]-1]
+ *  src, next:  NFA states of a move being built, or
+ *              threads of lazyLeftmost()
+ *  starts:     Where the threads of src and next began
+ *  newSet:     Sorted set of the new state
+ *  flushes:    Times the cache was emptied
+ */
+struct limregex_lazy{
+    struct FAnfa nfa;
+    int utf8;
+    unsigned char *anyFinal;
+    int classLen;
+    unsigned char map[256];
+    unsigned char classByte[256];
+    int maxStates;
+    int states;
+    int *row;
+    unsigned char *final;
+    int *setStart;
+    int *setEl;
+    int setElSize;
+    struct setIndex index;
+    struct sparseSet src;
+    struct sparseSet next;
+    int *starts;
+    int *newSet;
+    long long flushes;
+};
+
+/*  Close NFA states of a set over Epsilon-moves   */
+static void lazyClose(const struct limregex_lazy *lazy, struct sparseSet *set){
+    struct FAdelta ***index = lazy->nfa.index;
+    for(int i = 0; i<set->len; i++){
+        int el = set->dense[i];
+        if(el == FINAL_STATE || el >= lazy->nfa.len)continue;
+        for(struct FAdelta **d = index[el]; d < index[el+1] && (*d)->input == EPSILON; d++)
+            sparseAdd(set, (*d)->after);
+    }
+}
+
+/*  Find the state of lazy->newSet[], or add it.
+ *  @return int State, <0 for a full cache
+ */
+static int lazyFind(struct limregex_lazy *lazy, int setSize){
+    const int *set = lazy->newSet;
+    unsigned int hash = setHash(set, setSize);
+    for(int n = setIndexFirst(&lazy->index, hash); n >= 0; n = lazy->index.next[n]){
+        if(lazy->index.hash[n] != hash
+                || lazy->setStart[n+1] - lazy->setStart[n] != setSize)
+            continue;
+        if(memcmp(lazy->setEl + lazy->setStart[n], set, setSize * sizeof(int))==0)
+            return n;
+    }
+    int n = lazy->states;
+    if(n == lazy->maxStates || lazy->setStart[n] + setSize > lazy->setElSize
+            || setIndexAdd(&lazy->index, hash) < 0)
+        return(-1);
+    memcpy(lazy->setEl + lazy->setStart[n], set, setSize * sizeof(int));
+    lazy->setStart[n+1] = lazy->setStart[n] + setSize;
+    /*  FINAL_STATE sorts first */
+    lazy->final[n] = setSize && set[0] == FINAL_STATE;
+    for(int i = 0; i<setSize && !lazy->final[n]; i++)
+        if(set[i] >= lazy->nfa.len && set[i] < LAZY_SEARCH(lazy->nfa.len))
+            lazy->final[n] = lazy->anyFinal[set[i] % lazy->nfa.len];
+    for(int k = 0; k<lazy->classLen; k++)
+        lazy->row[n*lazy->classLen + k] = n? LAZY_UNKNOWN: LAZY_DEAD;
+    lazy->states++;
+    return n;
+}
+
+/*  Sort lazy->next into lazy->newSet[] and find its state.
+ *  @return int State, <0 for a full cache
+ */
+static int lazyFindNext(struct limregex_lazy *lazy){
+    int setSize = lazy->next.len;
+    memcpy(lazy->newSet, lazy->next.dense, setSize * sizeof(int));
+    qsort(lazy->newSet, setSize, sizeof(int), intCmp);
+    return lazyFind(lazy, setSize);
+}
+
+/*  Empty the cache, keep LAZY_DEAD, LAZY_START and
+ *  LAZY_SEARCH_START.
+ */
+static void lazyReset(struct limregex_lazy *lazy){
+    setIndexFree(&lazy->index);
+    lazy->index = (struct setIndex){0};
+    lazy->states = 0;
+    lazy->setStart[0] = 0;
+    for(int start = LAZY_DEAD; start <= LAZY_SEARCH_START; start++){
+        lazy->next.len = 0;
+        if(start == LAZY_START)sparseAdd(&lazy->next, 1);
+        if(start == LAZY_SEARCH_START)sparseAdd(&lazy->next, LAZY_SEARCH(lazy->nfa.len));
+        lazyClose(lazy, &lazy->next);
+        lazyFindNext(lazy);
+    }
+}
+
+/*  Build the move of a state on a byte class.
+ *  @return int Next state
+ */
+static int lazyStep(struct limregex_lazy *lazy, int state, int k){
+    const int len = lazy->nfa.len;
+    const int b = lazy->classByte[k];
+    const int search = LAZY_SEARCH(len);
+    struct FAdelta ***index = lazy->nfa.index;
+    lazy->src.len = 0;
+    lazy->next.len = 0;
+    for(int i = lazy->setStart[state]; i < lazy->setStart[state+1]; i++){
+        int el = lazy->setEl[i];
+        if(el == search){
+            /*  a match may begin at this byte, an empty
+             *  match is not a match of a search  */
+            sparseAdd(&lazy->next, search);
+            sparseAdd(&lazy->src, 1);
+        }else if(el < len)sparseAdd(&lazy->src, el);
+        else if(b >= 0x80 && b < 0xc0)
+            /*  continuation byte of '.'    */
+            sparseAdd(&lazy->next, (el >= 2*len)? el - len: el % len);
+        else
+            /*  not a continuation byte, taken by the
+             *  NFA state '.' goes to   */
+            sparseAdd(&lazy->src, el % len);
+    }
+    lazyClose(lazy, &lazy->src);
+    for(int i = 0; i<lazy->src.len; i++){
+        int el = lazy->src.dense[i];
+        if(el == FINAL_STATE)continue;
+        for(struct FAdelta **d = index[el]; d < index[el+1]; d++){
+            int input = (*d)->input;
+            if(input == EPSILON)continue;
+            if((input & METACHAR)? !isCharType(input, (char)b): (input & 0xff) != b)
+                continue;
+            if(lazy->utf8 && input == ('.' | METACHAR) && b >= 0xc2 && b <= 0xf4)
+                /*  2, 3 or 4 bytes character   */
+                sparseAdd(&lazy->next, LAZY_UTF8(len, (*d)->after, 1 + (b >= 0xe0) + (b >= 0xf0)));
+            else sparseAdd(&lazy->next, (*d)->after);
+        }
+    }
+    lazyClose(lazy, &lazy->next);
+    int next = lazyFindNext(lazy);
+    if(next >= 0){
+        lazy->row[state*lazy->classLen + k] = next;
+        return next;
+    }
+    /*  full, start over with the new state kept aside */
+    int setSize = lazy->next.len;
+    memcpy(lazy->src.dense, lazy->newSet, setSize * sizeof(int));
+    lazy->flushes++;
+    lazyReset(lazy);
+    memcpy(lazy->newSet, lazy->src.dense, setSize * sizeof(int));
+    return lazyFind(lazy, setSize);
+}
+
+/*  Longest match with a lazy DFA
+ *  @param  str     Input String
+ *  @param  end     End of str[], or NULL for '\0' ended
+ *  @return int     Length of the longest match
+ */
+static int lazyExec(struct limregex_lazy *lazy, const unsigned char str[], const unsigned char *end){
+    const unsigned char *c = str;
+    int state = LAZY_START;
+    int match = 0;
+    while(!INPUT_END(c) && state){
+        int k = lazy->map[*c++];
+        int next = lazy->row[state*lazy->classLen + k];
+        if(next == LAZY_UNKNOWN)next = lazyStep(lazy, state, k);
+        state = next;
+        if(state < 0)return 0;
+        if(lazy->final[state])
+            match = c - str;
+    }
+    return match;
+}
+
+/*  Add a thread of lazyLeftmost() and the states it
+ *  reaches by Epsilon-moves, a state already there is
+ *  kept with its earlier start.
+ *  @param  starts  Start of each thread of set
+ */
+static void lazyAdd(const struct limregex_lazy *lazy, struct sparseSet *set, int starts[], int el, int start){
+    struct FAdelta ***index = lazy->nfa.index;
+    int i = set->len;
+    if(!sparseAdd(set, el))return;
+    for(; i<set->len; i++){
+        starts[i] = start;
+        el = set->dense[i];
+        if(el == FINAL_STATE || el >= lazy->nfa.len)continue;
+        for(struct FAdelta **d = index[el]; d < index[el+1] && (*d)->input == EPSILON; d++)
+            sparseAdd(set, (*d)->after);
+    }
+}
+
+/*  Start of the leftmost match, by threads of the NFA
+ *  each with the earliest start reaching its state, a
+ *  thread a byte from from to before, in one pass.
+ *  It ends once a match is seen and no thread began
+ *  before it, '.' is taken as lazyStep() takes it.
+ *  @param  from    No match begins before
+ *  @param  before  A match begins before
+ *  @return const unsigned char*    Start of the match
+ *                  NULL    for no match.
+ */
+static const unsigned char *lazyLeftmost(struct limregex_lazy *lazy, const unsigned char *from, const unsigned char *before, const unsigned char *end){
+    const int len = lazy->nfa.len;
+    struct FAdelta ***index = lazy->nfa.index;
+    struct sparseSet *clist = &lazy->src, *nlist = &lazy->next;
+    int *cstarts = lazy->starts, *nstarts = lazy->starts + LAZY_SEARCH(len) + 1;
+    int match = -1;
+    clist->len = 0;
+    for(const unsigned char *c = from; ; c++){
+        const int pos = c - from;
+        const int b = INPUT_END(c)? -1: *c;
+        if(b < 0x80 || b >= 0xc0){
+            /*  the end or not a continuation byte, the
+             *  character '.' takes is cut and ends here  */
+            int pseudo = 0;
+            for(int n = 0; n<clist->len; n++)
+                pseudo |= clist->dense[n] >= len;
+            if(pseudo){
+                nlist->len = 0;
+                for(int n = 0; n<clist->len; n++)
+                    lazyAdd(lazy, nlist, nstarts, clist->dense[n] % len, cstarts[n]);
+                struct sparseSet *t = clist; clist = nlist; nlist = t;
+                int *s = cstarts; cstarts = nstarts; nstarts = s;
+            }
+        }
+        /*  threads are in the order of their start */
+        if(match < 0 && c < before)lazyAdd(lazy, clist, cstarts, 1, pos);
+        for(int n = 0; n<clist->len; n++)
+            if(clist->dense[n] == FINAL_STATE && pos > cstarts[n]
+                    && (match < 0 || cstarts[n] < match))
+                match = cstarts[n];
+        if(match >= 0 && (!clist->len || cstarts[0] >= match))break;
+        if(b < 0)break;
+        nlist->len = 0;
+        for(int n = 0; n<clist->len; n++){
+            int el = clist->dense[n];
+            if(match >= 0 && cstarts[n] >= match)break;
+            if(el == FINAL_STATE)continue;
+            if(el >= len){
+                /*  continuation byte of '.'    */
+                if(b >= 0x80 && b < 0xc0)
+                    lazyAdd(lazy, nlist, nstarts, (el >= 2*len)? el - len: el % len, cstarts[n]);
+                continue;
+            }
+            for(struct FAdelta **d = index[el]; d < index[el+1]; d++){
+                int input = (*d)->input;
+                if(input == EPSILON)continue;
+                if((input & METACHAR)? !isCharType(input, (char)b): (input & 0xff) != b)
+                    continue;
+                if(lazy->utf8 && input == ('.' | METACHAR) && b >= 0xc2 && b <= 0xf4)
+                    /*  2, 3 or 4 bytes character   */
+                    lazyAdd(lazy, nlist, nstarts, LAZY_UTF8(len, (*d)->after, 1 + (b >= 0xe0) + (b >= 0xf0)), cstarts[n]);
+                else lazyAdd(lazy, nlist, nstarts, (*d)->after, cstarts[n]);
+            }
+        }
+        if(!nlist->len && (match >= 0 || c >= before))break;
+        struct sparseSet *t = clist; clist = nlist; nlist = t;
+        int *s = cstarts; cstarts = nstarts; nstarts = s;
+    }
+    return (match < 0)? NULL: from + match;
+}
+
+/*  Unanchored search with a lazy DFA, the same way as
+ *  regexpSearch().
+ *  @param  str     Input String
+ *  @param  end     End of str[], or NULL for '\0' ended
+ *  @param  start   Offset of the match in str
+ *  @return int     Length of the leftmost longest match
+ */
+static int lazySearch(struct limregex_lazy *lazy, const unsigned char str[], const unsigned char *end, int *start){
+    const int classLen = lazy->classLen;
+    const unsigned char *c = str;
+    /*  no match begins before from */
+    const unsigned char *from = str;
+    int state = LAZY_SEARCH_START;
+    for(;;){
+        if(state == LAZY_SEARCH_START){
+            while(!INPUT_END(c)
+                    && lazy->row[LAZY_SEARCH_START*classLen + lazy->map[*c]] == LAZY_SEARCH_START)
+                c++;
+            from = c;
+        }
+        if(INPUT_END(c))return 0;
+        int k = lazy->map[*c++];
+        int next = lazy->row[state*classLen + k];
+        if(next == LAZY_UNKNOWN)next = lazyStep(lazy, state, k);
+        state = next;
+        if(state < 0)return 0;
+        if(lazy->final[state])break;
+    }
+    /*  leftmost match begins before that end   */
+    const unsigned char *b = lazyLeftmost(lazy, from, c, end);
+    if(!b)return 0;
+    *start = b - str;
+    return lazyExec(lazy, b, end);
+}
+
+/*  Compile a Regular Expression to a lazy DFA, states
+ *  are built by matching.
+ *  @param  regexStr    RegExp string
+ *  @param  cacheSize   Bytes for the DFA states, they are
+ *                      built again once it is full
+ *  @return struct limregex_lazy*   limregex_lazy_free() it
+ *                  NULL    for malformed or empty RegExp,
+ *                          or no memory.
+ */
+struct limregex_lazy *limregex_lazy_compile(const char regexStr[], size_t cacheSize){
+    return limregex_lazy_compile_n(regexStr, strlen(regexStr), cacheSize);
+}
+
+/*  Compile a Regular Expression in a buffer to a lazy
+ *  DFA, '\0' is a character.
+ *  @param  regexBuf    RegExp
+ *  @param  regexLen    Length of regexBuf[]
+ *  @param  cacheSize   Bytes for the DFA states, they are
+ *                      built again once it is full
+ *  @return struct limregex_lazy*   limregex_lazy_free() it
+ *                  NULL    for malformed RegExp, regexLen = 0,
+ *                          or no memory.
+ */
+struct limregex_lazy *limregex_lazy_compile_n(const char regexBuf[], size_t regexLen, size_t cacheSize){
+    struct limregex_lazy *lazy = calloc(1, sizeof(*lazy));
+    if(!lazy)return NULL;
+    if(regexpNfa(NULL, &lazy->nfa, &regexBuf, &regexLen, 0, 0, NULL) <= 0){
+        free(lazy);
+        return NULL;
+    }
+    const int len = lazy->nfa.len;
+    for(struct FAdelta **d = lazy->nfa.index[0]; d < lazy->nfa.index[len]; d++)
+        if((*d)->input == ('.' | METACHAR))lazy->utf8 = 1;
+    int classMap[256];
+    lazy->classLen = regexpByteClass(lazy->nfa.index, len, lazy->utf8, classMap);
+    for(int b = 256; b--;){
+        lazy->map[b] = classMap[b];
+        lazy->classByte[classMap[b]] = b;
+    }
+    /*  a quarter for the sets, at most all NFA states
+     *  and LAZY_UTF8() of them a set   */
+    int setMax = LAZY_SEARCH(len) + 1;
+    size_t rowSize = sizeof(int)*lazy->classLen + sizeof(int) + 1;
+    lazy->maxStates = cacheSize/4*3/rowSize;
+    if(lazy->maxStates < LAZY_STATES_MIN)lazy->maxStates = LAZY_STATES_MIN;
+    lazy->setElSize = cacheSize/4/sizeof(int);
+    if(lazy->setElSize < setMax*4)lazy->setElSize = setMax*4;
+    lazy->row = malloc(sizeof(int)*lazy->classLen*lazy->maxStates);
+    lazy->final = malloc(lazy->maxStates);
+    lazy->setStart = malloc(sizeof(int)*(lazy->maxStates+1));
+    lazy->setEl = malloc(sizeof(int)*lazy->setElSize);
+    lazy->newSet = malloc(sizeof(int)*setMax);
+    lazy->src = (struct sparseSet){
+        .dense = malloc(sizeof(int)*setMax), .sparse = calloc(setMax, sizeof(int)) };
+    lazy->next = (struct sparseSet){
+        .dense = malloc(sizeof(int)*setMax), .sparse = calloc(setMax, sizeof(int)) };
+    lazy->anyFinal = calloc(len, 1);
+    lazy->starts = malloc(sizeof(int)*setMax*2);
+    if(!lazy->row || !lazy->final || !lazy->setStart || !lazy->setEl || !lazy->newSet
+            || !lazy->src.dense || !lazy->src.sparse
+            || !lazy->next.dense || !lazy->next.sparse || !lazy->anyFinal || !lazy->starts){
+        limregex_lazy_free(lazy);
+        return NULL;
+    }
+    for(struct FAdelta **d = lazy->nfa.index[0]; d < lazy->nfa.index[len]; d++){
+        if((*d)->input != ('.' | METACHAR))continue;
+        lazy->src.len = 0;
+        sparseAdd(&lazy->src, (*d)->after);
+        lazyClose(lazy, &lazy->src);
+        for(int i = 0; i<lazy->src.len; i++)
+            if(lazy->src.dense[i] == FINAL_STATE)lazy->anyFinal[(*d)->after] = 1;
+    }
+    lazyReset(lazy);
+    if(lazy->states <= LAZY_SEARCH_START){
+        limregex_lazy_free(lazy);
+        return NULL;
+    }
+    return lazy;
+}
+
+/*  Free a lazy DFA.
+ *  @param  lazy    limregex_lazy_compile() compiled, or NULL
+ */
+void limregex_lazy_free(struct limregex_lazy *lazy){
+    if(!lazy)return;
+    regexpNfaFree(NULL, &lazy->nfa);
+    setIndexFree(&lazy->index);
+    free(lazy->row);
+    free(lazy->final);
+    free(lazy->setStart);
+    free(lazy->setEl);
+    free(lazy->newSet);
+    free(lazy->src.dense);
+    free(lazy->src.sparse);
+    free(lazy->next.dense);
+    free(lazy->next.sparse);
+    free(lazy->anyFinal);
+    free(lazy->starts);
+    free(lazy);
+}
+
+/*  Lazy DFA
+ *  @param  str     Input String
+ *  @param  lazy    limregex_lazy_compile() compiled
+ *  @return int     Length of the longest match
+ *                  >0  accepted
+ *                  0   rejected
+ */
+int limregex_lazy_exec(const char str[], struct limregex_lazy *lazy){
+    return lazyExec(lazy, (const unsigned char *)str, NULL);
+}
+
+/*  Lazy DFA on a buffer, '\0' is a character.
+ *  @param  buf     Input buffer
+ *  @param  len     Length of buf[]
+ *  @param  lazy    limregex_lazy_compile() compiled
+ *  @return int     Length of the longest match
+ *                  >0  accepted
+ *                  0   rejected
+ */
+int limregex_lazy_exec_n(const char buf[], size_t len, struct limregex_lazy *lazy){
+    return lazyExec(lazy, (const unsigned char *)buf, (const unsigned char *)buf + len);
+}
+
+/*  Unanchored search with a lazy DFA
+ *  @param  str     Input String
+ *  @param  lazy    limregex_lazy_compile() compiled
+ *  @param  start   Offset of the match in str
+ *  @return int     Length of the leftmost longest match
+ *                  >0  found
+ *                  0   not found
+ */
+int limregex_lazy_search(const char str[], struct limregex_lazy *lazy, int *start){
+    return lazySearch(lazy, (const unsigned char *)str, NULL, start);
+}
+
+/*  Unanchored search with a lazy DFA on a buffer,
+ *  '\0' is a character.
+ *  @param  buf     Input buffer
+ *  @param  len     Length of buf[]
+ *  @param  lazy    limregex_lazy_compile() compiled
+ *  @param  start   Offset of the match in buf
+ *  @return int     Length of the leftmost longest match
+ *                  >0  found
+ *                  0   not found
+ */
+int limregex_lazy_search_n(const char buf[], size_t len, struct limregex_lazy *lazy, int *start){
+    return lazySearch(lazy, (const unsigned char *)buf, (const unsigned char *)buf + len, start);
+}
+
+/*  Number of times the cache of a lazy DFA was full.
+ *  @param  lazy    limregex_lazy_compile() compiled
+ *  @return long long   Times the states were built again
+ */
+long long limregex_lazy_flushes(const struct limregex_lazy *lazy){
+    return lazy->flushes;
+}
+
+/*  Submatches by a tagged NFA, run one thread a state
+ *  in the order of preference, no backtracking.
+ *  nfa:        The NFA, its group moves are tagged
+ *  groups:     Number of groups
+ *  slots:      Capture slots of a thread, 2*(groups+1)
+ *  moveStart:  Moves of state l are move[moveStart[l]] ...
+ *              move[moveStart[l+1]-1], the preferred first
+ *  moves:      Number of moves
+ */
+struct limregex_capture{
+    struct FAnfa nfa;
+    int groups;
+    int slots;
+    int *moveStart;
+    struct FAdelta **move;
+    int moves;
+};
+
+/*  Threads of a step of captureRun(), by their state,
+ *  thread n has the slots caps[n*slots] ...
+ */
+struct captureList{
+    struct sparseSet set;
+    int *caps;
+};
+
+/*  Scratch of a run, one stack frame is 3 int:
+ *  state to add, or slot and value to restore
+ */
+struct captureRun{
+    const struct limregex_capture *cap;
+    struct captureList list[2];
+    int *stack;
+    int *caps;
+};
+
+#define CAPTURE_ADD (-1)
+
+/*  Add a thread and the states it reaches by Epsilon-
+ *  moves to a list, a state already there is kept with
+ *  its thread, tagged moves store pos to their slot.
+ *  @param  caps    Slots of the thread, restored after
+ */
+static void captureAdd(struct captureRun *run, struct captureList *list, int state, int *caps, int pos){
+    const struct limregex_capture *cap = run->cap;
+    const int len = cap->nfa.len;
+    int *stack = run->stack;
+    int top = 0;
+    stack[top++] = CAPTURE_ADD;
+    stack[top++] = state;
+    stack[top++] = 0;
+    while(top){
+        top -= 3;
+        int slot = stack[top], el = stack[top+1], v = stack[top+2];
+        if(slot != CAPTURE_ADD){
+            caps[slot] = v;
+            continue;
+        }
+        if(v)caps[-v] = pos;
+        int n = list->set.len;
+        if(!sparseAdd(&list->set, el))continue;
+        memcpy(list->caps + n*cap->slots, caps, sizeof(int)*cap->slots);
+        if(el >= len)continue;
+        /*  the preferred move is taken first   */
+        for(int i = cap->moveStart[el+1]; i-- > cap->moveStart[el];){
+            const struct FAdelta *d = cap->move[i];
+            if(d->input != EPSILON)continue;
+            if(d->nparen < 0){
+                stack[top++] = -d->nparen;
+                stack[top++] = 0;
+                stack[top++] = caps[-d->nparen];
+            }
+            stack[top++] = CAPTURE_ADD;
+            stack[top++] = d->after;
+            stack[top++] = (d->nparen < 0)? d->nparen: 0;
+        }
+    }
+}
+
+/*  Match a tagged NFA, the way lazyStep() takes '.'.
+ *  @param  str     Input String
+ *  @param  end     End of str[], or NULL for '\0' ended
+ *  @param  search  1 for a match anywhere, 0 for one at str
+ *  @param  spans   Array to store the slots of the match
+ *  @return int     Length of the leftmost longest match,
+ *                  empty matches are not matches
+ */
+static int captureRun(struct captureRun *run, const unsigned char str[], const unsigned char *end, int search, int spans[]){
+    const struct limregex_capture *cap = run->cap;
+    const int len = cap->nfa.len, slots = cap->slots;
+    struct captureList *clist = run->list, *nlist = run->list + 1;
+    int *caps = run->caps;
+    int match = 0;
+    clist->set.len = 0;
+    for(const unsigned char *c = str; ; c++){
+        const int pos = c - str;
+        const int b = INPUT_END(c)? -1: *c;
+        if(b < 0x80 || b >= 0xc0){
+            /*  the end or not a continuation byte, the
+             *  character '.' takes is cut and ends here,
+             *  as utf8Width()  */
+            int pseudo = 0;
+            for(int n = 0; n<clist->set.len; n++)
+                pseudo |= clist->set.dense[n] >= len;
+            if(pseudo){
+                nlist->set.len = 0;
+                for(int n = 0; n<clist->set.len; n++){
+                    int el = clist->set.dense[n];
+                    memcpy(caps, clist->caps + n*slots, sizeof(int)*slots);
+                    captureAdd(run, nlist, (el >= len)? el % len: el, caps, pos);
+                }
+                struct captureList *t = clist; clist = nlist; nlist = t;
+            }
+        }
+        if(search? !match: c == str){
+            /*  a match from here is the least preferred  */
+            for(int s = 0; s<slots; s++)caps[s] = -1;
+            caps[GROUP_OPEN(0)] = pos;
+            captureAdd(run, clist, 1, caps, pos);
+        }
+        nlist->set.len = 0;
+        for(int n = 0; n<clist->set.len; n++){
+            int el = clist->set.dense[n];
+            int *tcaps = clist->caps + n*slots;
+            if(match && tcaps[GROUP_OPEN(0)] > spans[GROUP_OPEN(0)])continue;
+            if(el == FINAL_STATE){
+                if(pos > tcaps[GROUP_OPEN(0)]){
+                    memcpy(spans, tcaps, sizeof(int)*slots);
+                    spans[GROUP_CLOSE(0)] = pos;
+                    match = pos - tcaps[GROUP_OPEN(0)];
+                }
+                continue;
+            }
+            if(b < 0)continue;
+            memcpy(caps, tcaps, sizeof(int)*slots);
+            if(el >= len){
+                /*  continuation byte of '.'    */
+                if(b >= 0x80 && b < 0xc0)
+                    captureAdd(run, nlist, (el >= 2*len)? el - len: el % len, caps, pos + 1);
+                continue;
+            }
+            for(int i = cap->moveStart[el+1]; i-- > cap->moveStart[el];){
+                const struct FAdelta *d = cap->move[i];
+                int input = d->input;
+                if(input == EPSILON)continue;
+                if((input & METACHAR)? !isCharType(input, (char)b): (input & 0xff) != b)
+                    continue;
+                if(input == ('.' | METACHAR) && b >= 0xc2 && b <= 0xf4)
+                    /*  2, 3 or 4 bytes character   */
+                    captureAdd(run, nlist, LAZY_UTF8(len, d->after, 1 + (b >= 0xe0) + (b >= 0xf0)), caps, pos + 1);
+                else captureAdd(run, nlist, d->after, caps, pos + 1);
+            }
+        }
+        if(b < 0 || (!nlist->set.len && (match || !search)))break;
+        struct captureList *t = clist; clist = nlist; nlist = t;
+    }
+    return match;
+}
+
+/*  Run a tagged NFA with scratch of this call, the
+ *  program is only read.
+ *  @return int     Length of the match,
+ *                  <0  for no memory.
+ */
+static int captureExec(const struct limregex_capture *cap, const char str[], const char *end, int search, int spans[]){
+    const int states = LAZY_SEARCH(cap->nfa.len);
+    const int slots = cap->slots;
+    /*  sparse and dense of two lists, their slots, the
+     *  stack of two frames a move and the slots in use  */
+    size_t size = (size_t)states*(4 + 2*slots) + 3*(2*cap->moves + 1) + slots;
+    int *buf = calloc(size, sizeof(int));
+    if(!buf)return(NO_MEMORY);
+    struct captureRun run = {.cap = cap};
+    int *p = buf;
+    for(int l = 0; l<2; l++){
+        run.list[l].set.sparse = p;     p += states;
+        run.list[l].set.dense = p;      p += states;
+        run.list[l].caps = p;           p += states*slots;
+    }
+    run.stack = p;  p += 3*(2*cap->moves + 1);
+    run.caps = p;
+    for(int s = 0; s<slots; s++)spans[s] = -1;
+    int match = captureRun(&run, (const unsigned char *)str, (const unsigned char *)end, search, spans);
+    if(!match)
+        for(int s = 0; s<slots; s++)spans[s] = -1;
+    free(buf);
+    return match;
+}
+
+/*  Compile a Regular Expression for submatches, groups
+ *  are numbered by their '(' from 1.
+ *  @param  regexStr    RegExp string
+ *  @return struct limregex_capture*    limregex_capture_free() it
+ *                  NULL    for malformed or empty RegExp,
+ *                          or no memory.
+ */
+struct limregex_capture *limregex_capture_compile(const char regexStr[]){
+    return limregex_capture_compile_n(regexStr, strlen(regexStr));
+}
+
+/*  Compile a Regular Expression in a buffer for submatches,
+ *  '\0' is a character.
+ *  @param  regexBuf    RegExp
+ *  @param  regexLen    Length of regexBuf[]
+ *  @return struct limregex_capture*    limregex_capture_free() it
+ *                  NULL    for malformed RegExp, regexLen = 0,
+ *                          or no memory.
+ */
+struct limregex_capture *limregex_capture_compile_n(const char regexBuf[], size_t regexLen){
+    struct limregex_capture *cap = calloc(1, sizeof(*cap));
+    if(!cap)return NULL;
+    if(regexpNfa(NULL, &cap->nfa, &regexBuf, &regexLen, 0, 1, NULL) <= 0){
+        free(cap);
+        return NULL;
+    }
+    const int len = cap->nfa.len;
+    cap->groups = cap->nfa.groups;
+    cap->slots = 2*(cap->groups + 1);
+    cap->moves = cap->nfa.index[len] - cap->nfa.index[0];
+    cap->moveStart = calloc(len + 1, sizeof(int));
+    cap->move = malloc(sizeof(struct FAdelta *)*cap->moves);
+    if(!cap->moveStart || !cap->move){
+        limregex_capture_free(cap);
+        return NULL;
+    }
+    /*  moves made later are preferred, regexpPostNfa()
+     *  builds the left of '|' and the loop of '*' last   */
+    for(int i = 0; i<cap->moves; i++)
+        cap->moveStart[cap->nfa.deltas[i].before + 1]++;
+    for(int l = 0; l<len; l++)
+        cap->moveStart[l+1] += cap->moveStart[l];
+    int *fill = malloc(sizeof(int)*len);
+    if(!fill){
+        limregex_capture_free(cap);
+        return NULL;
+    }
+    memcpy(fill, cap->moveStart, sizeof(int)*len);
+    for(int i = 0; i<cap->moves; i++)
+        cap->move[fill[cap->nfa.deltas[i].before]++] = cap->nfa.deltas + i;
+    free(fill);
+    return cap;
+}
+
+/*  Free a tagged NFA.
+ *  @param  cap limregex_capture_compile() compiled, or NULL
+ */
+void limregex_capture_free(struct limregex_capture *cap){
+    if(!cap)return;
+    regexpNfaFree(NULL, &cap->nfa);
+    free(cap->moveStart);
+    free(cap->move);
+    free(cap);
+}
+
+/*  Number of groups of a tagged NFA.
+ *  @param  cap limregex_capture_compile() compiled
+ *  @return int Number of groups
+ */
+int limregex_capture_groups(const struct limregex_capture *cap){
+    return cap->groups;
+}
+
+/*  Longest match at the start of a string with its
+ *  submatches.
+ *  @param  str     Input String
+ *  @param  cap     limregex_capture_compile() compiled
+ *  @param  spans   2*(groups+1) int to store the start and
+ *                  end of the match, then of each group,
+ *                  -1 for groups not in the match
+ *  @return int     Length of the match,
+ *                  <0  for no memory.
+ */
+int limregex_capture_exec(const char str[], const struct limregex_capture *cap, int spans[]){
+    return captureExec(cap, str, NULL, 0, spans);
+}
+
+/*  limregex_capture_exec() on a buffer, '\0' is a character.
+ *  @param  len     Length of buf[]
+ */
+int limregex_capture_exec_n(const char buf[], size_t len, const struct limregex_capture *cap, int spans[]){
+    return captureExec(cap, buf, buf + len, 0, spans);
+}
+
+/*  Leftmost longest match anywhere in a string with its
+ *  submatches, offsets are from str.
+ *  @return int     Length of the match,
+ *                  <0  for no memory.
+ */
+int limregex_capture_search(const char str[], const struct limregex_capture *cap, int spans[]){
+    return captureExec(cap, str, NULL, 1, spans);
+}
+
+/*  limregex_capture_search() on a buffer, '\0' is a
+ *  character.
+ *  @param  len     Length of buf[]
+ */
+int limregex_capture_search_n(const char buf[], size_t len, const struct limregex_capture *cap, int spans[]){
+    return captureExec(cap, buf, buf + len, 1, spans);
+}
+
+/*  Native code of a DFA, a block of x86-64 code a state:
+ *  it takes the next byte by compares of byte ranges, or
+ *  by a jump table for more than JIT_RANGES ranges, and
+ *  jumps to the block of the next state. The bytes of a
+ *  state move as in the VM, the first move of the state
+ *  taking a byte wins. The code is called as
+ *      int code(str, end, stop)
+ *  stop[0] is where it stopped, stop[1] the end of the
+ *  last accepting state entered or NULL, it returns
+ *  JIT_FAIL, JIT_END_ACCEPT, JIT_END_REJECT or JIT_FINAL.
+ *  It stops at the first accepting state if stop[2] is
+ *  not NULL. rdi is the next byte, rsi the end or 0 for
+ *  a string ending with '\0', rdx stop[], rax stop[1]
+ *  and ecx the byte.   */
+typedef int (*jitFunction)(const unsigned char *, const unsigned char *, const unsigned char *[3]);
+
+/*  Ints before the code, the first is 1 for an
+ *  accepting initial state */
+#define JIT_HEADER 4
+#define JIT_RANGES 8
+
+/*  Compiled RegExp of limregex_jit_compile().
+ *  code:       Native code, NULL for the VM
+ *  pages:      Executable pages of the code
+ *  pagesSize:  Bytes of pages
+ *  program:    VM instructions, if there is no code
+ *  initAccept: 1 for an accepting initial state
+ */
+struct limregex_jit{
+    jitFunction code;
+    void *pages;
+    size_t pagesSize;
+    int *program;
+    int initAccept;
+};
+
+/*  Labels of the code, the first 4 are also what the
+ *  code returns.
+ *  JIT_FAIL:       No move for the next byte
+ *  JIT_END_ACCEPT: Input ended in an accepting state
+ *  JIT_END_REJECT: Input ended in another state
+ *  JIT_FINAL:      Moved into a state with no move left
+ *  JIT_OUT:        Stores stop[] and returns
+ *  JIT_UTF8:       r8 = width of the character '.' takes
+ *  Labels of state s are JIT_LABEL(s, enum jitState).  */
+enum jitLabel{
+    JIT_FAIL,
+    JIT_END_ACCEPT,
+    JIT_END_REJECT,
+    JIT_FINAL,
+    JIT_OUT,
+    JIT_UTF8,
+    JIT_STATES
+};
+
+#ifdef JIT_X86_64
+
+/*  JIT_MOVE:   A byte moves into the state
+ *  JIT_ENTER:  Moved into the state, past the bytes
+ *  JIT_BODY:   Takes the next byte
+ *  JIT_ANY:    '.' moves into the state from a UTF-8
+ *              lead byte
+ *  JIT_ZERO:   Byte 0, the end if rsi is 0 */
+enum jitState{
+    JIT_MOVE,
+    JIT_ENTER,
+    JIT_BODY,
+    JIT_ANY,
+    JIT_ZERO,
+    JIT_STATE
+};
+#define JIT_LABEL(s, l) (JIT_STATES + (s)*JIT_STATE + (l))
+
+/*  A rel32 or a jump table entry, label - base  */
+struct jitFix{
+    size_t at;
+    size_t base;
+    int label;
+};
+
+/*  Code being emitted, bytes past size are counted but
+ *  not stored, so the size needed is known.  */
+struct jitBuf{
+    struct regexpArena *arena;
+    unsigned char *code;
+    size_t size;
+    size_t len;
+    size_t *label;
+    struct jitFix *fix;
+    int fixLen;
+    int fixSize;
+    int noMemory;
+};
+
+static void jitBytes(struct jitBuf *jit, const char bytes[], int n){
+    for(int i = 0; i<n; i++, jit->len++)
+        if(jit->len < jit->size)jit->code[jit->len] = bytes[i];
+}
+
+static void jitImm32(struct jitBuf *jit, int32_t imm){
+    uint32_t u = (uint32_t)imm;
+    const char bytes[4] = {(char)(u & 0xff), (char)(u>>8 & 0xff), (char)(u>>16 & 0xff), (char)(u>>24)};
+    jitBytes(jit, bytes, 4);
+}
+
+/*  Emit 4 bytes of label - base, patched once every
+ *  label is known  */
+static void jitRef(struct jitBuf *jit, int label, size_t base){
+    if(jit->fixLen == jit->fixSize){
+        int size = jit->fixSize? jit->fixSize*2: 256;
+        struct jitFix *fix = arenaRealloc(jit->arena, jit->fix, sizeof(struct jitFix)*size);
+        if(!fix){
+            jit->noMemory = 1;
+            return;
+        }
+        jit->fix = fix;
+        jit->fixSize = size;
+    }
+    jit->fix[jit->fixLen++] = (struct jitFix){ .at = jit->len, .base = base, .label = label };
+    jitImm32(jit, 0);
+}
+
+/*  An instruction op rel32 to a label    */
+static void jitJump(struct jitBuf *jit, const char op[], int opLen, int label){
+    jitBytes(jit, op, opLen);
+    jitRef(jit, label, jit->len + 4);
+}
+
+/*  Jump to a label if the byte in ecx is in lo ... hi    */
+static void jitRange(struct jitBuf *jit, int lo, int hi, int label){
+    if(lo == hi){
+        /*  cmp cl, lo; je  */
+        jitBytes(jit, "\x80\xf9", 2);
+        jitBytes(jit, (const char []){(char)lo}, 1);
+        jitJump(jit, "\x0f\x84", 2, label);
+    }else if(lo == 0 || hi == 255){
+        /*  cmp ecx, hi; jbe or cmp ecx, lo; jae   */
+        jitBytes(jit, "\x81\xf9", 2);
+        jitImm32(jit, lo? lo: hi);
+        jitJump(jit, lo? "\x0f\x83": "\x0f\x86", 2, label);
+    }else{
+        /*  lea r8d, [rcx-lo]; cmp r8d, hi-lo; jbe  */
+        jitBytes(jit, "\x44\x8d\x81", 3);
+        jitImm32(jit, -lo);
+        jitBytes(jit, "\x41\x81\xf8", 3);
+        jitImm32(jit, hi - lo);
+        jitJump(jit, "\x0f\x86", 2, label);
+    }
+}
+
+/*  1 if a DFA move takes byte b, as the VM tests it  */
+static int jitTakes(int input, int b){
+    const int class = charClass[b];
+    if(!(input & METACHAR))return (input & 0xff) == b;
+    switch(input & 0xff){
+        case '.': return 1;
+        case 'd': return (class & CHAR_DIGIT) != 0;
+        case 'D': return !(class & CHAR_DIGIT);
+        case 'w': return (class & CHAR_WORD) != 0;
+        case 'W': return !(class & CHAR_WORD);
+        case 's': return (class & CHAR_SPACE) != 0;
+        case 'S': return !(class & CHAR_SPACE);
+        /*  atoms of sub_splitMetachar()    */
+        case 'l': return (class & (CHAR_WORD|CHAR_DIGIT)) == CHAR_WORD;
+        case 'p': return !(class & (CHAR_WORD|CHAR_SPACE));
+        case 'o': return !(class & (CHAR_WORD|CHAR_SPACE)) && !utf8Atom(b);
+        case 'c':
+        case '2':
+        case '3':
+        case '4': return utf8Atom(b) == (input & 0xff);
+    }
+    return 0;
+}
+
+/*  Width of the character at rdi into r8, as utf8Width():
+ *  the lead byte and the continuation bytes after it, up
+ *  to the width of the lead byte and the end. r9 is that
+ *  width, r10 the bytes left, unsigned so none are short
+ *  with rsi 0, where '\0' ends the character.    */
+static const char jitUtf8[] =
+    "\x41\xb9\x02\x00\x00\x00"         /*  mov r9d, 2          */
+    "\x81\xf9\xe0\x00\x00\x00"         /*  cmp ecx, 0xe0       */
+    "\x72\x14"                         /*  jb width            */
+    "\x41\xb9\x03\x00\x00\x00"         /*  mov r9d, 3          */
+    "\x81\xf9\xf0\x00\x00\x00"         /*  cmp ecx, 0xf0       */
+    "\x72\x06"                         /*  jb width            */
+    "\x41\xb9\x04\x00\x00\x00"         /*  mov r9d, 4          */
+    "\x41\xb8\x01\x00\x00\x00"         /*  width: mov r8d, 1   */
+    "\x49\x89\xf2"                     /*  mov r10, rsi        */
+    "\x49\x29\xfa"                     /*  sub r10, rdi        */
+    "\x4d\x39\xca"                     /*  cmp r10, r9         */
+    "\x73\x03"                         /*  jae next            */
+    "\x4d\x89\xd1"                     /*  mov r9, r10         */
+    "\x4d\x39\xc8"                     /*  next: cmp r8, r9    */
+    "\x73\x1a"                         /*  jae done            */
+    "\x46\x0f\xb6\x1c\x07"               /*  movzx r11d, byte [rdi+r8]  */
+    "\x41\x81\xe3\xc0\x00\x00\x00"     /*  and r11d, 0xc0      */
+    "\x41\x81\xfb\x80\x00\x00\x00"     /*  cmp r11d, 0x80      */
+    "\x75\x05"                         /*  jne done            */
+    "\x49\xff\xc0"                     /*  inc r8              */
+    "\xeb\xe1"                         /*  jmp next            */
+    "\xc3";                            /*  done: ret           */
+
+/*  Emit the block of a state.
+ *  @param  target  256 int to use
+ */
+static void jitState(struct jitBuf *jit, const struct FAdfa *dfa, int s, int target[]){
+    struct FAdelta **move = dfa->index[s];
+    const int moves = dfa->index[s+1] - move;
+    const int accepting = (dfa->labelState[s] & FINAL) != 0;
+    /*  inc rdi */
+    jit->label[JIT_LABEL(s, JIT_MOVE)] = jit->len;
+    jitBytes(jit, "\x48\xff\xc7", 3);
+    /*  mov rax, rdi; cmp qword [rdx+16], 0; jne  */
+    jit->label[JIT_LABEL(s, JIT_ENTER)] = jit->len;
+    if(accepting || !moves)jitBytes(jit, "\x48\x89\xf8", 3);
+    if(accepting && moves)jitJump(jit, "\x48\x83\x7a\x10\x00\x0f\x85", 7, JIT_FINAL);
+    jit->label[JIT_LABEL(s, JIT_BODY)] = jit->len;
+    if(!moves){
+        jitJump(jit, "\xe9", 1, JIT_FINAL);
+    }else{
+        /*  cmp rdi, rsi; je; movzx ecx, byte [rdi]    */
+        jitBytes(jit, "\x48\x39\xf7", 3);
+        jitJump(jit, "\x0f\x84", 2, accepting? JIT_END_ACCEPT: JIT_END_REJECT);
+        jitBytes(jit, "\x0f\xb6\x0f", 3);
+        int ranges = 0;
+        for(int b = 0; b<256; b++){
+            int m = 0;
+            while(m<moves && !jitTakes(move[m]->input, b))m++;
+            if(m == moves)target[b] = JIT_FAIL;
+            else if((move[m]->input & METACHAR) && (move[m]->input & 0xff) == '.' && b >= 0xc2 && b <= 0xf4)
+                target[b] = JIT_LABEL(move[m]->after, JIT_ANY);
+            else target[b] = JIT_LABEL(move[m]->after, JIT_MOVE);
+        }
+        /*  byte 0 is tested for the end only as it comes,
+         *  so the input is not scanned for it first    */
+        const int zero = target[0];
+        target[0] = JIT_LABEL(s, JIT_ZERO);
+        for(int b = 0; b<256; b++)
+            if(target[b] != JIT_FAIL && (b == 0 || target[b] != target[b-1]))ranges++;
+        if(ranges <= JIT_RANGES){
+            for(int lo = 0, hi; lo<256; lo = hi+1){
+                for(hi = lo; hi<255 && target[hi+1] == target[lo]; hi++);
+                if(target[lo] != JIT_FAIL)jitRange(jit, lo, hi, target[lo]);
+            }
+            jitJump(jit, "\xe9", 1, JIT_FAIL);
+        }else{
+            /*  lea r8, [rip+10]; movsxd r9, [r8+rcx*4];
+             *  add r9, r8; jmp r9; the table   */
+            jitBytes(jit, "\x4c\x8d\x05\x0a\x00\x00\x00\x4d\x63\x0c\x88\x4d\x01\xc1\x41\xff\xe1", 17);
+            const size_t base = jit->len;
+            for(int b = 0; b<256; b++)
+                jitRef(jit, target[b], base);
+        }
+        /*  test rsi, rsi; jz; jmp  */
+        jit->label[JIT_LABEL(s, JIT_ZERO)] = jit->len;
+        jitBytes(jit, "\x48\x85\xf6", 3);
+        jitJump(jit, "\x0f\x84", 2, accepting? JIT_END_ACCEPT: JIT_END_REJECT);
+        jitJump(jit, "\xe9", 1, zero);
+    }
+    /*  call JIT_UTF8; add rdi, r8; jmp JIT_ENTER   */
+    jit->label[JIT_LABEL(s, JIT_ANY)] = jit->len;
+    jitJump(jit, "\xe8", 1, JIT_UTF8);
+    jitBytes(jit, "\x4c\x01\xc7", 3);
+    jitJump(jit, "\xe9", 1, JIT_LABEL(s, JIT_ENTER));
+}
+
+/*  Compile DFA to x86-64 code, after JIT_HEADER int.
+ *  The code uses no absolute address, it runs once
+ *  copied anywhere.
+ *  @return int     Length of out[] used.
+ *                  <-1 for the length out[] needs,
+ *                  NO_MEMORY for no memory.
+ */
+static int regexpDfaJit(const struct FAdfa *dfa, int out[], int outLen){
+    const int states = dfa->len;
+    struct jitBuf jit = { .arena = dfa->arena, .code = (unsigned char *)(out + JIT_HEADER),
+        .size = (outLen > JIT_HEADER)? sizeof(int)*(size_t)(outLen - JIT_HEADER): 0 };
+    jit.label = arenaCalloc(dfa->arena, JIT_LABEL(states, 0), sizeof(size_t));
+    int *target = arenaAlloc(dfa->arena, sizeof(int)*256);
+    if(!jit.label || !target){
+        arenaFree(dfa->arena, target);
+        arenaFree(dfa->arena, jit.label);
+        return(NO_MEMORY);
+    }
+    /*  xor eax, eax; jmp to the initial state, it does
+     *  not accept before a byte as in the VM */
+    jitBytes(&jit, "\x31\xc0", 2);
+    jitJump(&jit, "\xe9", 1, JIT_LABEL(0, JIT_BODY));
+    jit.label[JIT_UTF8] = jit.len;
+    jitBytes(&jit, jitUtf8, sizeof(jitUtf8) - 1);
+    /*  r8d = why it stopped, store stop[] and return it   */
+    jit.label[JIT_FAIL] = jit.len;
+    jitBytes(&jit, "\x45\x31\xc0", 3);
+    jitJump(&jit, "\xe9", 1, JIT_OUT);
+    jit.label[JIT_END_ACCEPT] = jit.len;
+    jitBytes(&jit, "\x41\xb8\x01\x00\x00\x00", 6);
+    jitJump(&jit, "\xe9", 1, JIT_OUT);
+    jit.label[JIT_END_REJECT] = jit.len;
+    jitBytes(&jit, "\x41\xb8\x02\x00\x00\x00", 6);
+    jitJump(&jit, "\xe9", 1, JIT_OUT);
+    jit.label[JIT_FINAL] = jit.len;
+    jitBytes(&jit, "\x41\xb8\x03\x00\x00\x00", 6);
+    jit.label[JIT_OUT] = jit.len;
+    jitBytes(&jit, "\x48\x89\x3a" "\x48\x89\x42\x08" "\x44\x89\xc0" "\xc3", 11);
+    for(int s = 0; s<states; s++)
+        jitState(&jit, dfa, s, target);
+    for(int i = 0; i<jit.fixLen; i++){
+        const struct jitFix *fix = jit.fix + i;
+        if(fix->at + 4 > jit.size)continue;
+        uint32_t rel = (uint32_t)(jit.label[fix->label] - fix->base);
+        for(int k = 0; k<4; k++)
+            jit.code[fix->at + k] = rel>>(8*k) & 0xff;
+    }
+    arenaFree(dfa->arena, jit.fix);
+    arenaFree(dfa->arena, target);
+    arenaFree(dfa->arena, jit.label);
+    if(jit.noMemory || jit.len > (size_t)(INT_MAX/2))return(NO_MEMORY);
+    const int used = JIT_HEADER + (int)((jit.len + sizeof(int)-1) / sizeof(int));
+    if(used > outLen)return(-used);
+    /*  int3 to the end of the last int    */
+    memset(jit.code + jit.len, 0xcc, sizeof(int)*(used - JIT_HEADER) - jit.len);
+    memset(out, 0, sizeof(int)*JIT_HEADER);
+    out[0] = (dfa->labelState[0] & FINAL) != 0;
+    return used;
+}
+
+#endif
+
+/*  Compile a Regular Expression to native code, in
+ *  executable pages of its own. Only x86-64 is built,
+ *  on other machines or with no executable pages it is
+ *  VM instructions.
+ *  @param  regexStr    RegExp string
+ *  @return struct limregex_jit*    NULL for malformed
+ *                      RegExp, regexStr = "\0" or no
+ *                      memory
+ */
+struct limregex_jit *limregex_jit_compile(const char regexStr[]){
+    return limregex_jit_compile_n(regexStr, strlen(regexStr));
+}
+
+/*  Compile a Regular Expression in a buffer to native
+ *  code, '\0' is a character.
+ *  @param  regexBuf    RegExp
+ *  @param  regexLen    Length of regexBuf[]
+ *  @return struct limregex_jit*    NULL for malformed
+ *                      RegExp, regexLen = 0 or no memory
+ */
+struct limregex_jit *limregex_jit_compile_n(const char regexBuf[], size_t regexLen){
+    struct limregex_jit *jit = calloc(1, sizeof(*jit));
+    struct limregex_context *context = jit? limregex_context_new(NULL): NULL;
+    if(!context){
+        free(jit);
+        return NULL;
+    }
+    int programLen;
+#ifdef JIT_X86_64
+    programLen = regexpContextCompile(context, &regexBuf, &regexLen, 0, regexpDfaJit);
+    if(programLen > 0){
+        size_t size = sizeof(int)*programLen;
+        void *pages = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(pages != MAP_FAILED){
+            memcpy(pages, context->program, size);
+            if(mprotect(pages, size, PROT_READ | PROT_EXEC) == 0){
+                jit->pages = pages;
+                jit->pagesSize = size;
+                jit->initAccept = context->program[0];
+                jit->code = (jitFunction)(uintptr_t)((int *)pages + JIT_HEADER);
+            }else munmap(pages, size);
+        }
+    }
+#endif
+    if(!jit->code){
+        programLen = limregex_context_compile(context, regexBuf, regexLen, LIMREGEX_VM);
+        jit->program = (programLen > 0)? malloc(sizeof(int)*programLen): NULL;
+        if(jit->program)limregex_context_emit(context, jit->program, programLen);
+    }
+    limregex_context_free(context);
+    if(!jit->code && !jit->program){
+        free(jit);
+        return NULL;
+    }
+    return jit;
+}
+
+/*  Free a compiled RegExp of limregex_jit_compile().
+ *  @param  jit     limregex_jit_compile() made, or NULL
+ */
+void limregex_jit_free(struct limregex_jit *jit){
+    if(!jit)return;
+#ifdef JIT_X86_64
+    if(jit->pages)munmap(jit->pages, jit->pagesSize);
+#endif
+    free(jit->program);
+    free(jit);
+}
+
+/*  1 if limregex_jit_compile() made native code, 0 for
+ *  VM instructions.
+ */
+int limregex_jit_native(const struct limregex_jit *jit){
+    return jit->code != NULL;
+}
+
+/*  Run native code, or the VM, in a match mode as
+ *  regexpVM() does.
+ *  @param  end     End of str[], or NULL for '\0' ended
+ *  @return int     Match Length, 1 for LIMREGEX_IS_MATCH
+ */
+static int jitExec(const struct limregex_jit *jit, const char str[], const char *end, int mode){
+    if(!jit->code)return regexpVM(str, end, jit->program, mode);
+    const unsigned char *s = (const unsigned char *)str;
+    const unsigned char *e = (const unsigned char *)end;
+    if(mode == LIMREGEX_IS_MATCH && jit->initAccept)return 1;
+    const unsigned char *stop[3] = { NULL, NULL, (mode == LIMREGEX_IS_MATCH)? s: NULL };
+    int stopped = jit->code(s, e, stop);
+    switch(mode){
+        case LIMREGEX_IS_MATCH:
+            return stop[1] != NULL;
+        case LIMREGEX_LONGEST:
+            return stop[1]? stop[1] - s: 0;
+        case LIMREGEX_FULL:
+            return (stopped == JIT_END_ACCEPT || (stopped == JIT_FINAL
+                        && (e? stop[0] == e: !*stop[0])))? stop[0] - s: 0;
+    }
+    return (stopped == JIT_END_ACCEPT || stopped == JIT_FINAL)? stop[0] - s: 0;
+}
+
+/*  Native code, the same as limregexec().
+ *  @param  str     Input String
+ *  @param  jit     limregex_jit_compile() compiled
+ *  @return int     Match Length
+ *                  >0  accepted
+ *                  0   rejected
+ */
+int limregex_jit_exec(const char str[], const struct limregex_jit *jit){
+    return jitExec(jit, str, NULL, 0);
+}
+
+/*  Native code on a buffer, '\0' is a character, the
+ *  same as limregexec_n().
+ *  @param  buf     Input buffer
+ *  @param  len     Length of buf[]
+ *  @param  jit     limregex_jit_compile() compiled
+ *  @return int     Match Length
+ *                  >0  accepted
+ *                  0   rejected
+ */
+int limregex_jit_exec_n(const char buf[], size_t len, const struct limregex_jit *jit){
+    return jitExec(jit, buf, buf + len, 0);
+}
+
+/*  Native code on a buffer in a match mode, '\0' is a
+ *  character, the same as limregexec_mode_n().
+ *  @param  buf     Input buffer
+ *  @param  len     Length of buf[]
+ *  @param  jit     limregex_jit_compile() compiled
+ *  @param  mode    LIMREGEX_IS_MATCH, LIMREGEX_LONGEST or
+ *                  LIMREGEX_FULL
+ *  @return int     Match Length, 1 for LIMREGEX_IS_MATCH
+ *                  >0  accepted
+ *                  0   rejected
+ */
+int limregex_jit_exec_mode_n(const char buf[], size_t len, const struct limregex_jit *jit, int mode){
+    return jitExec(jit, buf, buf + len, mode);
+}
+
+/*  Header of a program saved by limregex_save().
+ *  magic:      SAVE_MAGIC
+ *  order:      SAVE_ORDER, read in another byte order on
+ *              a machine of the other endianness
+ *  version:    SAVE_VERSION, of the program layout
+ *  intSize:    sizeof(int)
+ *  kind:       enum limregex_kind
+ *  length:     Number of int of the program
+ *  patterns:   Number of patterns of a set table
+ *  The program follows the header, int aligned.
+ */
+struct saveHeader{
+    unsigned int magic;
+    unsigned int order;
+    unsigned short version;
+    unsigned char intSize;
+    unsigned char kind;
+    int length;
+    int patterns;
+    int reserved[3];
+};
+
+/*  Save a compiled program with a header.
+ *  @param  buf         Buffer to store the saved program
+ *  @param  bufSize     Size of buf[]
+ *  @param  program     limregexcl() compiled VM instructions
+ *                      or limregex_compile_table() compiled
+ *                      table
+ *  @param  programLen  Number of int of program[]
+ *  @param  kind        LIMREGEX_VM or LIMREGEX_TABLE
+ *  @return long    Number of bytes used in buf[], programs
+ *                  saved one after another are a bundle
+ *                  <0  for no enough space in buf[],
+ *                      or bad program.
+ */
+long limregex_save(char buf[], size_t bufSize, const int program[], int programLen, int kind){
+    /*  as limregex_load() takes it, a table has its header   */
+    if(programLen < 1 || (kind != LIMREGEX_VM && kind != LIMREGEX_TABLE)
+            || (kind == LIMREGEX_TABLE && programLen < TBL_DELTA))
+        return(-1);
+    struct saveHeader header = {
+        .magic = SAVE_MAGIC, .order = SAVE_ORDER,
+        .version = SAVE_VERSION, .intSize = sizeof(int),
+        .kind = kind, .length = programLen,
+        .patterns = (kind == LIMREGEX_TABLE)? program[TBL_PATTERNS]: 0 };
+    size_t size = sizeof(header) + sizeof(int)*(size_t)programLen;
+    if(size > bufSize)return(-1);
+    memcpy(buf, &header, sizeof(header));
+    memcpy(buf + sizeof(header), program, sizeof(int)*programLen);
+    return size;
+}
+
+/*  Load a saved program in place, such as from a mmap()ed
+ *  file, only the header is checked.
+ *  @param  buf     limregex_save() saved program, int aligned
+ *  @param  bufSize Bytes from buf to the end of the buffer
+ *  @param  kind    Pointer to store the kind of the program
+ *  @param  used    Pointer to store bytes of the saved
+ *                  program, the next one of a bundle begins
+ *                  there, or NULL
+ *  @return const int*  The program in buf[]
+ *                      NULL    for bad header, or program
+ *                              of another byte order, int
+ *                              size or layout version.
+ */
+const int *limregex_load(const char buf[], size_t bufSize, int *kind, size_t *used){
+    const struct saveHeader *header = (const struct saveHeader *)buf;
+    const int *program = (const int *)(buf + sizeof(*header));
+    if(bufSize < sizeof(*header) || (uintptr_t)buf % sizeof(int))return NULL;
+    if(header->magic != SAVE_MAGIC || header->order != SAVE_ORDER
+            || header->version != SAVE_VERSION
+            || header->intSize != sizeof(int)
+            || header->length < 1
+            || (size_t)header->length > (bufSize - sizeof(*header))/sizeof(int))
+        return NULL;
+    if(header->kind == LIMREGEX_TABLE){
+        /*  the rows must be in the program */
+        if(header->length < TBL_DELTA || program[TBL_CLASSES] < 1
+                || program[TBL_ROWS] < 1
+                || program[TBL_ROWS] > (header->length - TBL_DELTA)/program[TBL_CLASSES])
+            return NULL;
+    }else if(header->kind != LIMREGEX_VM)return NULL;
+    *kind = header->kind;
+    if(used)*used = sizeof(*header) + sizeof(int)*header->length;
+    return program;
+}
+
+/*  Compiled program in the cache.
+ *  next:       Next entry of the hash bucket
+ *  newer:      LRU list, toward the most recently used
+ *  older:      LRU list, toward the least recently used
+ *  refs:       limregex_cache_get() not put back yet
+ *  cached:     In the shard, 0 once evicted
+ *  bytes:      Size of the entry, counted in the budget
+ *  key:        RegExp, after program[]
+ */
+struct cacheEntry{
+    struct cacheEntry *next;
+    struct cacheEntry *newer;
+    struct cacheEntry *older;
+    uint64_t hash;
+    int shard;
+    int kind;
+    int refs;
+    int cached;
+    size_t bytes;
+    size_t keyLen;
+    const char *key;
+    int program[];
+};
+
+/*  A shard of the cache, all under lock.
+ *  bucket:     Hash buckets, bucketLen of them
+ *  newest:     Most recently used entry
+ *  oldest:     Least recently used entry
+ */
+struct cacheShard{
+    pthread_mutex_t lock;
+    struct cacheEntry **bucket;
+    int bucketLen;
+    int entries;
+    struct cacheEntry *newest;
+    struct cacheEntry *oldest;
+    size_t bytes;
+    long long hits;
+    long long misses;
+    long long evictions;
+};
+
+static struct cacheShard cacheShards[CACHE_SHARDS];
+static pthread_once_t cacheOnce = PTHREAD_ONCE_INIT;
+static atomic_size_t cacheBudget = CACHE_BUDGET;
+
+static void cacheInit(void){
+    for(int n = 0; n<CACHE_SHARDS; n++)
+        pthread_mutex_init(&cacheShards[n].lock, NULL);
+}
+
+/*  FNV-1a hash of a RegExp and its kind   */
+static uint64_t cacheHash(const char key[], size_t keyLen, int kind){
+    uint64_t hash = 0xcbf29ce484222325u ^ (uint64_t)kind;
+    for(size_t i = 0; i<keyLen; i++){
+        hash ^= (unsigned char)key[i];
+        hash *= 0x100000001b3u;
+    }
+    return hash;
+}
+
+/*  Unlink an entry from the LRU list of its shard  */
+static void cacheUnlink(struct cacheShard *shard, struct cacheEntry *entry){
+    if(entry->newer)entry->newer->older = entry->older;
+    else shard->newest = entry->older;
+    if(entry->older)entry->older->newer = entry->newer;
+    else shard->oldest = entry->newer;
+}
+
+/*  Link an entry as the most recently used of its shard  */
+static void cacheLink(struct cacheShard *shard, struct cacheEntry *entry){
+    entry->newer = NULL;
+    entry->older = shard->newest;
+    if(shard->newest)shard->newest->newer = entry;
+    shard->newest = entry;
+    if(!shard->oldest)shard->oldest = entry;
+}
+
+/*  Make an entry the most recently used of its shard  */
+static void cacheTouch(struct cacheShard *shard, struct cacheEntry *entry){
+    if(shard->newest == entry)return;
+    cacheUnlink(shard, entry);
+    cacheLink(shard, entry);
+}
+
+/*  Drop an entry from its shard, it is freed when
+ *  the last limregex_cache_put() comes.   */
+static void cacheEvict(struct cacheShard *shard, struct cacheEntry *entry){
+    struct cacheEntry **p = &shard->bucket[entry->hash % shard->bucketLen];
+    while(*p != entry)p = &(*p)->next;
+    *p = entry->next;
+    cacheUnlink(shard, entry);
+    shard->bytes -= entry->bytes;
+    shard->entries--;
+    shard->evictions++;
+    entry->cached = 0;
+    if(!entry->refs)free(entry);
+}
+
+/*  Evict least recently used entries until a shard is
+ *  in its budget, keep is not evicted.  */
+static void cacheTrim(struct cacheShard *shard, const struct cacheEntry *keep){
+    size_t budget = atomic_load(&cacheBudget)/CACHE_SHARDS;
+    while(shard->bytes > budget && shard->oldest && shard->oldest != keep)
+        cacheEvict(shard, shard->oldest);
+}
+
+/*  Find a RegExp in a shard and take a reference.
+ *  @return struct cacheEntry*  NULL for not found
+ */
+static struct cacheEntry *cacheFind(struct cacheShard *shard, uint64_t hash, const char key[], size_t keyLen, int kind){
+    if(!shard->bucketLen)return NULL;
+    for(struct cacheEntry *entry = shard->bucket[hash % shard->bucketLen]; entry; entry = entry->next)
+        if(entry->hash == hash && entry->kind == kind && entry->keyLen == keyLen
+                && !memcmp(entry->key, key, keyLen)){
+            entry->refs++;
+            cacheTouch(shard, entry);
+            return entry;
+        }
+    return NULL;
+}
+
+/*  Add an entry to a shard, the buckets grow with
+ *  the entries.
+ *  @return int <0  for no memory for the buckets
+ */
+static int cacheInsert(struct cacheShard *shard, struct cacheEntry *entry){
+    if(shard->entries >= shard->bucketLen){
+        int bucketLen = shard->bucketLen? shard->bucketLen*2: CACHE_BUCKETS;
+        struct cacheEntry **bucket = calloc(bucketLen, sizeof(*bucket));
+        if(!bucket)return(-1);
+        for(int n = 0; n<shard->bucketLen; n++)
+            for(struct cacheEntry *e = shard->bucket[n], *next; e; e = next){
+                next = e->next;
+                e->next = bucket[e->hash % bucketLen];
+                bucket[e->hash % bucketLen] = e;
+            }
+        free(shard->bucket);
+        shard->bucket = bucket;
+        shard->bucketLen = bucketLen;
+    }
+    entry->next = shard->bucket[entry->hash % shard->bucketLen];
+    shard->bucket[entry->hash % shard->bucketLen] = entry;
+    entry->cached = 1;
+    cacheLink(shard, entry);
+    shard->bytes += entry->bytes;
+    shard->entries++;
+    return 0;
+}
+
+/*  Allocator of cacheCompile(), data is the bytes left  */
+static void *cacheAlloc(size_t size, void *data){
+    size_t *left = data;
+    if(size > *left)return NULL;
+    *left -= size;
+    return malloc(size);
+}
+
+static void cacheFree(void *ptr, size_t size, void *data){
+    *(size_t *)data += size;
+    free(ptr);
+}
+
+/*  Compile a RegExp to a new entry of the exact size,
+ *  the compile takes at most CACHE_PROGRAM_MAX int.
+ *  @return struct cacheEntry*  NULL for malformed RegExp
+ */
+static struct cacheEntry *cacheCompile(const char key[], size_t keyLen, int kind){
+    size_t left = sizeof(int)*(size_t)CACHE_PROGRAM_MAX;
+    struct limregex_allocator allocator = { cacheAlloc, cacheFree, &left };
+    struct limregex_context *context = limregex_context_new(&allocator);
+    if(!context)return NULL;
+    int programLen = limregex_context_compile(context, key, keyLen, kind);
+    struct cacheEntry *entry = (programLen > 0)?
+        malloc(sizeof(*entry) + sizeof(int)*programLen + keyLen): NULL;
+    if(entry){
+        limregex_context_emit(context, entry->program, programLen);
+        entry->key = (const char *)(entry->program + programLen);
+        memcpy((char *)entry->key, key, keyLen);
+        entry->keyLen = keyLen;
+        entry->kind = kind;
+        entry->refs = 1;
+        entry->bytes = sizeof(*entry) + sizeof(int)*programLen + keyLen;
+    }
+    limregex_context_free(context);
+    return entry;
+}
+
+/*  Compile a RegExp in a buffer through the cache.
+ *  Lookups lock a shard only, a RegExp is compiled
+ *  out of the lock and the first one added wins.
+ *  @param  regexBuf    RegExp
+ *  @param  regexLen    Length of regexBuf[]
+ *  @param  kind        LIMREGEX_VM or LIMREGEX_TABLE
+ *  @return const int*  The compiled program, valid until
+ *                      limregex_cache_put()
+ *                      NULL    for malformed RegExp.
+ */
+const int *limregex_cache_get_n(const char regexBuf[], size_t regexLen, int kind){
+    if(kind != LIMREGEX_VM && kind != LIMREGEX_TABLE)return NULL;
+    pthread_once(&cacheOnce, cacheInit);
+    uint64_t hash = cacheHash(regexBuf, regexLen, kind);
+    int n = (hash >> 32) % CACHE_SHARDS;
+    struct cacheShard *shard = &cacheShards[n];
+    pthread_mutex_lock(&shard->lock);
+    struct cacheEntry *entry = cacheFind(shard, hash, regexBuf, regexLen, kind);
+    if(entry)shard->hits++;
+    else shard->misses++;
+    pthread_mutex_unlock(&shard->lock);
+    if(entry)return entry->program;
+
+    struct cacheEntry *compiled = cacheCompile(regexBuf, regexLen, kind);
+    if(!compiled)return NULL;
+    compiled->hash = hash;
+    compiled->shard = n;
+    pthread_mutex_lock(&shard->lock);
+    if((entry = cacheFind(shard, hash, regexBuf, regexLen, kind)))
+        free(compiled);
+    else if(cacheInsert(shard, compiled) < 0){
+        /*  not kept, freed by limregex_cache_put() */
+        compiled->cached = 0;
+        entry = compiled;
+    }else{
+        entry = compiled;
+        cacheTrim(shard, entry);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return entry->program;
+}
+
+/*  Compile a RegExp through the cache.
+ *  @param  regexStr    RegExp string
+ *  @param  kind        LIMREGEX_VM or LIMREGEX_TABLE
+ *  @return const int*  The compiled program, valid until
+ *                      limregex_cache_put()
+ *                      NULL    for malformed RegExp.
+ */
+const int *limregex_cache_get(const char regexStr[], int kind){
+    return limregex_cache_get_n(regexStr, strlen(regexStr), kind);
+}
+
+/*  Give back a program of limregex_cache_get(), an
+ *  evicted one is freed with the last reference.
+ *  @param  program limregex_cache_get() compiled program
+ */
+void limregex_cache_put(const int *program){
+    if(!program)return;
+    struct cacheEntry *entry = (struct cacheEntry *)
+        ((char *)program - offsetof(struct cacheEntry, program));
+    struct cacheShard *shard = &cacheShards[entry->shard];
+    pthread_mutex_lock(&shard->lock);
+    int drop = !--entry->refs && !entry->cached;
+    pthread_mutex_unlock(&shard->lock);
+    if(drop)free(entry);
+}
+
+/*  Set the byte budget of the cache.
+ *  @param  bytes   Budget, 0 to empty the cache
+ */
+void limregex_cache_budget(size_t bytes){
+    pthread_once(&cacheOnce, cacheInit);
+    atomic_store(&cacheBudget, bytes);
+    for(int n = 0; n<CACHE_SHARDS; n++){
+        pthread_mutex_lock(&cacheShards[n].lock);
+        cacheTrim(&cacheShards[n], NULL);
+        pthread_mutex_unlock(&cacheShards[n].lock);
+    }
+}
+
+/*  Read the counters of the cache.
+ *  @param  stats   Pointer to store the counters
+ */
+void limregex_cache_report(struct limregex_cache_stats *stats){
+    pthread_once(&cacheOnce, cacheInit);
+    *stats = (struct limregex_cache_stats){0};
+    for(int n = 0; n<CACHE_SHARDS; n++){
+        struct cacheShard *shard = &cacheShards[n];
+        pthread_mutex_lock(&shard->lock);
+        stats->hits += shard->hits;
+        stats->misses += shard->misses;
+        stats->evictions += shard->evictions;
+        stats->bytes += shard->bytes;
+        stats->entries += shard->entries;
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+/*  Byte equivalence classes of a compiled table.
+ *  @param  table       limregex_compile_table() compiled table
+ *  @param  classMap    Array to store class of each byte,
+ *                      or NULL
+ *  @return int     Number of classes
+ */
+int limregex_table_classes(const int table[], unsigned char classMap[]){
+    const unsigned char *map = (const unsigned char *)(table + TBL_CLASSMAP);
+    if(classMap)
+        for(int b = 0; b<256; b++)classMap[b] = map[b] - 1;
+    return table[TBL_CLASSES] - 1;
 }
 
 /* 
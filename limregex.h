@@ -27,15 +27,18 @@
 #ifndef LIMREGEX_H
 #define LIMREGEX_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 /*  '\\' (backslash) as escape character    */
 #define ESCAPE_CHAR 0x5c
 
-/*  Max number of bytes of an multibyte character   */
-#define CHARW_MAX MB_CUR_MAX
+/*  Compilers return it for malformed RegExp, other
+ *  values <0 are for no enough space    */
+#define MALFORMED (-2)
 
-/*  Encoding    */
-#define ENCODING UTF_8
-#define UTF_8 "en_US.UTF-8"
+/*  Max number of bytes of an UTF-8 character   */
+#define CHARW_MAX 4
 
 /*  Compile a Regular Expression.
  *  Input:  Array of uint to store instructions,
@@ -45,11 +48,634 @@
  */
 int limregexcl( int[], int,    const char[]    );
 
+/*  Compile a Regular Expression in a buffer, '\0' is
+ *  a character.
+ *  Input:  Array of uint to store instructions,
+ *          Above array size
+ *          RegExp buffer,
+ *          Buffer length
+ *  Output: Number of RegExp VM instructions
+ */
+int limregexcl_n( int[],   int,    const char[],   size_t  );
+
 /*  Execute a compiled RegExp.
  *  Input:  String,
  *          Array of instructions
  *  Output: Match Length
  */
-int limregexec( const char[],   int[]   );
+int limregexec( const char[],   const int[] );
+
+/*  Execute a compiled RegExp on a buffer, '\0' is
+ *  a character.
+ *  Input:  Buffer,
+ *          Buffer length,
+ *          Array of instructions
+ *  Output: Match Length
+ */
+int limregexec_n( const char[], size_t, const int[] );
+
+/*  Match modes of limregexec_mode() and
+ *  limregex_exec_table_mode(), all anchored at the start.
+ *  LIMREGEX_IS_MATCH:  1 at the first accepting byte, no
+ *                      length is computed
+ *  LIMREGEX_LONGEST:   Length of the longest match, runs
+ *                      until no move is left
+ *  LIMREGEX_FULL:      Length if all the input matches
+ */
+enum limregex_mode{
+    LIMREGEX_IS_MATCH = 1,
+    LIMREGEX_LONGEST,
+    LIMREGEX_FULL
+};
+
+/*  Execute a compiled RegExp in a match mode.
+ *  Input:  String,
+ *          Array of instructions,
+ *          Match mode
+ *  Output: Match Length, or 1 for LIMREGEX_IS_MATCH
+ */
+int limregexec_mode( const char[], const int[], int );
+
+/*  Execute a compiled RegExp on a buffer in a match
+ *  mode, '\0' is a character.
+ *  Input:  Buffer,
+ *          Buffer length,
+ *          Array of instructions,
+ *          Match mode
+ *  Output: Match Length, or 1 for LIMREGEX_IS_MATCH
+ */
+int limregexec_mode_n( const char[],    size_t, const int[],    int );
+
+/*  Compile a Regular Expression to DFA transition table.
+ *  Input:  Array of int to store the table,
+ *          Above array size
+ *          RegExp string
+ *  Output: Number of int used by the table
+ */
+int limregex_compile_table( int[], int,    const char[]    );
+
+/*  Compile a Regular Expression in a buffer to DFA
+ *  transition table, '\0' is a character.
+ *  Input:  Array of int to store the table,
+ *          Above array size
+ *          RegExp buffer,
+ *          Buffer length
+ *  Output: Number of int used by the table
+ */
+int limregex_compile_table_n( int[],   int,    const char[],   size_t  );
+
+/*  Execute a compiled transition table.
+ *  Input:  String,
+ *          Array of table
+ *  Output: Longest Match Length
+ */
+int limregex_exec_table( const char[],   const int[] );
+
+/*  Execute a compiled transition table on a buffer,
+ *  '\0' is a character.
+ *  Input:  Buffer,
+ *          Buffer length,
+ *          Array of table
+ *  Output: Longest Match Length
+ */
+int limregex_exec_table_n( const char[],   size_t, const int[] );
+
+/*  Execute a compiled transition table in a match mode.
+ *  Input:  String,
+ *          Array of table,
+ *          Match mode
+ *  Output: Match Length, or 1 for LIMREGEX_IS_MATCH
+ */
+int limregex_exec_table_mode( const char[],    const int[],    int );
+
+/*  Execute a compiled transition table on a buffer in
+ *  a match mode, '\0' is a character.
+ *  Input:  Buffer,
+ *          Buffer length,
+ *          Array of table,
+ *          Match mode
+ *  Output: Match Length, or 1 for LIMREGEX_IS_MATCH
+ */
+int limregex_exec_table_mode_n( const char[],  size_t, const int[],    int );
+
+/*  Execute a compiled transition table on each field of
+ *  a batch, such as a column of strings, a few fields at
+ *  once, '\0' is a character.
+ *  Input:  Bytes of the fields,
+ *          n+1 offsets, field i is from offsets[i] to
+ *          offsets[i+1],
+ *          Number of fields n,
+ *          Array of table,
+ *          Bitmap to store 1 bit a field, bit i%8 of
+ *          byte i/8 set if field i matches, or NULL,
+ *          Array to store the match length of each
+ *          field, or NULL
+ *  Output: Number of matched fields
+ */
+size_t limregex_exec_batch( const char[],  const uint32_t[],   size_t, const int[],    unsigned char[],    int[] );
+
+/*  Search a compiled table anywhere in a string.
+ *  Input:  String,
+ *          Array of table,
+ *          Pointer to store offset of the match
+ *  Output: Length of the leftmost longest match
+ */
+int limregex_search( const char[],  const int[],    int * );
+
+/*  Search a compiled table anywhere in a buffer,
+ *  '\0' is a character.
+ *  Input:  Buffer,
+ *          Buffer length,
+ *          Array of table,
+ *          Pointer to store offset of the match
+ *  Output: Length of the leftmost longest match
+ */
+int limregex_search_n( const char[],    size_t, const int[],    int * );
+
+/*  Compile a set of Regular Expressions to one table.
+ *  Input:  Array of RegExp strings,
+ *          Number of RegExp strings,
+ *          Array of int to store the table,
+ *          Above array size
+ *  Output: Number of int used by the table
+ */
+int limregex_set_compile( const char *[],   int,    int[],  int );
+
+/*  Compile a set of Regular Expressions in buffers to one
+ *  table, '\0' is a character.
+ *  Input:  Array of RegExp buffers,
+ *          Array of buffer lengths,
+ *          Number of RegExp buffers,
+ *          Array of int to store the table,
+ *          Above array size
+ *  Output: Number of int used by the table
+ */
+int limregex_set_compile_n( const char *[], const size_t[], int,    int[],  int );
+
+/*  Count DFA states of a Regular Expression, DFAs
+ *  are minimized unless built with LIMREGEX_NO_MINIMIZE.
+ *  Input:  Array of 2 int to store the states before
+ *          and after minimization,
+ *          Max number of DFA moves,
+ *          RegExp string
+ *  Output: 2, <0 for more DFA moves than the max
+ */
+int limregex_dfa_states( int[2],   int,    const char[] );
+
+/*  Memory hook of a compile context, alloc(size, data)
+ *  returns NULL for no memory, free(ptr, size, data)
+ *  gives back what alloc() took. NULL alloc and free
+ *  are malloc() and free().
+ */
+struct limregex_allocator{
+    void *(*alloc)( size_t,    void * );
+    void (*free)( void *,  size_t, void * );
+    void *data;
+};
+
+/*  Compile context, keeps its memory from one compile
+ *  to the next, one thread uses it at a time.  */
+struct limregex_context;
+
+/*  Make a compile context.
+ *  Input:  Allocator, NULL for malloc()
+ *  Output: Context, NULL for no memory
+ */
+struct limregex_context *limregex_context_new( const struct limregex_allocator * );
+
+/*  Free a compile context and its memory.
+ *  Input:  Context
+ */
+void limregex_context_free( struct limregex_context * );
+
+/*  Compile a Regular Expression in a buffer, '\0' is
+ *  a character, into the context.
+ *  Input:  Context,
+ *          RegExp buffer,
+ *          Buffer length,
+ *          LIMREGEX_VM or LIMREGEX_TABLE
+ *  Output: Exact number of int of the program,
+ *          <0 for no memory or MALFORMED
+ */
+int limregex_context_compile( struct limregex_context *,   const char[],   size_t, int );
+
+/*  Compile a set of Regular Expressions to one table
+ *  in the context.
+ *  Input:  Context,
+ *          Array of RegExp strings,
+ *          Number of RegExp strings
+ *  Output: Exact number of int of the table,
+ *          <0 for no memory or MALFORMED
+ */
+int limregex_context_set_compile( struct limregex_context *,   const char *[], int );
+
+/*  Copy the program last compiled in the context.
+ *  Input:  Context,
+ *          Array of int to store the program,
+ *          Above array size
+ *  Output: Number of int copied, <0 for a short array
+ */
+int limregex_context_emit( const struct limregex_context *,    int[],  int );
+
+/*  Sizes and times of the stages of a compile.
+ *  postLen:    Length of the postfix RegExp
+ *  nfaStates:  NFA states
+ *  nfaMoves:   NFA moves
+ *  dfaSubsets: DFA states of the subset construction
+ *  dfaStates:  DFA states after minimization
+ *  dfaMoves:   DFA moves after minimization
+ *  programLen: Number of int of the program
+ *  postNs:     Nanoseconds to make the postfix RegExp,
+ *  nfaNs:      the NFA,
+ *  dfaNs:      the DFA,
+ *  minNs:      to minimize the DFA,
+ *  emitNs:     to make the VM instructions or the table
+ */
+struct limregex_stats{
+    int postLen;
+    int nfaStates;
+    int nfaMoves;
+    int dfaSubsets;
+    int dfaStates;
+    int dfaMoves;
+    int programLen;
+    long long postNs;
+    long long nfaNs;
+    long long dfaNs;
+    long long minNs;
+    long long emitNs;
+};
+
+/*  Read the stages of the compile last done in the
+ *  context, 0 for the stages it did not reach.
+ *  Input:  Context,
+ *          Pointer to store the stages
+ */
+void limregex_context_stats( const struct limregex_context *,  struct limregex_stats * );
+
+#ifdef LIMREGEX_STATS
+/*  Counters of limregexec() and limregex_exec_table()
+ *  and their variants, built with LIMREGEX_STATS only.
+ *  bytes:          Bytes of input consumed
+ *  instructions:   VM instructions run, or table lookups
+ *  visits:         Moves into each state, the VM counts
+ *                  them at the offset of the FRWRD of a
+ *                  state, the table at the row number,
+ *                  row 0 for the dead state
+ *  visitsLen:      Size of visits[], states past it are
+ *                  not counted
+ */
+struct limregex_exec_stats{
+    unsigned long long bytes;
+    unsigned long long instructions;
+    unsigned long long *visits;
+    size_t visitsLen;
+};
+
+/*  Add the matches of the calling thread to counters.
+ *  Input:  Counters, NULL to stop counting
+ */
+void limregex_exec_count( struct limregex_exec_stats * );
+#endif
+
+/*  Match a compiled set anywhere in a string.
+ *  Input:  String,
+ *          Array of table,
+ *          Array of (n+31)/32 uint to store bitmap of
+ *          matched pattern numbers
+ *  Output: Number of matched patterns
+ */
+int limregex_set_match( const char[],   const int[],    unsigned int[]  );
+
+/*  Match a compiled set anywhere in a buffer,
+ *  '\0' is a character.
+ *  Input:  Buffer,
+ *          Buffer length,
+ *          Array of table,
+ *          Array of (n+31)/32 uint to store bitmap of
+ *          matched pattern numbers
+ *  Output: Number of matched patterns
+ */
+int limregex_set_match_n( const char[], size_t, const int[],    unsigned int[]  );
+
+/*  State of a stream search, does not grow with
+ *  the stream.
+ *  table:  Compiled table
+ *  state:  Current search row
+ *  offset: Number of bytes searched
+ *  match:  End of the first match, -1 for none
+ */
+struct limregex_stream{
+    const int *table;
+    int state;
+    long long offset;
+    long long match;
+};
+
+/*  Start searching a compiled table in a stream.
+ *  Input:  Pointer to stream state,
+ *          Array of table
+ */
+void limregex_stream_init( struct limregex_stream *,   const int[] );
+
+/*  Search the next chunk of a stream.
+ *  Input:  Pointer to stream state,
+ *          Chunk,
+ *          Chunk length
+ *  Output: 1 if a match has ended, else 0
+ */
+int limregex_stream_feed( struct limregex_stream *,    const char[],   size_t  );
+
+/*  End a stream.
+ *  Input:  Pointer to stream state
+ *  Output: Offset of the end of the first match, <0 for none
+ */
+long long limregex_stream_end( struct limregex_stream * );
+
+/*  Search a large buffer by threads, each maps its chunk
+ *  from every search state.
+ *  Input:  Buffer,
+ *          Buffer length,
+ *          Array of table,
+ *          Number of threads
+ *  Output: Offset of the end of the first match, <0 for none
+ */
+long long limregex_search_parallel( const char[],  size_t, const int[],    int );
+
+/*  Lazy DFA, states are built while matching   */
+struct limregex_lazy;
+
+/*  Compile a Regular Expression to a lazy DFA.
+ *  Input:  RegExp string,
+ *          Bytes of the state cache
+ *  Output: Lazy DFA, NULL for malformed RegExp,
+ *          one thread uses it at a time
+ */
+struct limregex_lazy *limregex_lazy_compile( const char[],    size_t );
+
+/*  Compile a Regular Expression in a buffer to a lazy
+ *  DFA, '\0' is a character.
+ *  Input:  RegExp buffer,
+ *          Buffer length,
+ *          Bytes of the state cache
+ *  Output: Lazy DFA, NULL for malformed RegExp
+ */
+struct limregex_lazy *limregex_lazy_compile_n( const char[],   size_t, size_t  );
+
+/*  Free a lazy DFA.
+ *  Input:  Lazy DFA
+ */
+void limregex_lazy_free( struct limregex_lazy * );
+
+/*  Execute a lazy DFA.
+ *  Input:  String,
+ *          Lazy DFA
+ *  Output: Length of the longest match
+ */
+int limregex_lazy_exec( const char[],  struct limregex_lazy * );
+
+/*  Execute a lazy DFA on a buffer, '\0' is a character.
+ *  Input:  Buffer,
+ *          Buffer length,
+ *          Lazy DFA
+ *  Output: Length of the longest match
+ */
+int limregex_lazy_exec_n( const char[],    size_t, struct limregex_lazy * );
+
+/*  Search a lazy DFA anywhere in a string.
+ *  Input:  String,
+ *          Lazy DFA,
+ *          Pointer to store offset of the match
+ *  Output: Length of the leftmost longest match
+ */
+int limregex_lazy_search( const char[],    struct limregex_lazy *, int * );
+
+/*  Search a lazy DFA anywhere in a buffer, '\0' is
+ *  a character.
+ *  Input:  Buffer,
+ *          Buffer length,
+ *          Lazy DFA,
+ *          Pointer to store offset of the match
+ *  Output: Length of the leftmost longest match
+ */
+int limregex_lazy_search_n( const char[],  size_t, struct limregex_lazy *, int * );
+
+/*  Times the state cache of a lazy DFA was emptied.
+ *  Input:  Lazy DFA
+ *  Output: Number of times
+ */
+long long limregex_lazy_flushes( const struct limregex_lazy * );
+
+/*  Tagged NFA, a match with its submatches    */
+struct limregex_capture;
+
+/*  Compile a Regular Expression for submatches,
+ *  groups are numbered by their '(' from 1.
+ *  Input:  RegExp string
+ *  Output: Tagged NFA, NULL for malformed RegExp,
+ *          threads may share it
+ */
+struct limregex_capture *limregex_capture_compile( const char[] );
+
+/*  Compile a Regular Expression in a buffer for
+ *  submatches, '\0' is a character.
+ *  Input:  RegExp buffer,
+ *          Buffer length
+ *  Output: Tagged NFA, NULL for malformed RegExp
+ */
+struct limregex_capture *limregex_capture_compile_n( const char[],  size_t  );
+
+/*  Free a tagged NFA.
+ *  Input:  Tagged NFA
+ */
+void limregex_capture_free( struct limregex_capture * );
+
+/*  Number of groups of a tagged NFA.
+ *  Input:  Tagged NFA
+ *  Output: Number of groups
+ */
+int limregex_capture_groups( const struct limregex_capture * );
+
+/*  Longest match at the start of a string and its
+ *  submatches, of the preferred path: the left of '|'
+ *  first, '*' and '?' as many as they can.
+ *  Input:  String,
+ *          Tagged NFA,
+ *          Array of 2*(groups+1) int to store the start
+ *          and end of the match, then of each group,
+ *          -1 for groups not in the match
+ *  Output: Length of the match, <0 for no memory
+ */
+int limregex_capture_exec( const char[],   const struct limregex_capture *,    int[] );
+
+/*  Longest match at the start of a buffer and its
+ *  submatches, '\0' is a character.
+ *  Input:  Buffer,
+ *          Buffer length,
+ *          Tagged NFA,
+ *          Array of 2*(groups+1) int to store the spans
+ *  Output: Length of the match, <0 for no memory
+ */
+int limregex_capture_exec_n( const char[], size_t, const struct limregex_capture *,    int[] );
+
+/*  Search a tagged NFA anywhere in a string.
+ *  Input:  String,
+ *          Tagged NFA,
+ *          Array of 2*(groups+1) int to store the spans,
+ *          offsets from the string
+ *  Output: Length of the leftmost longest match,
+ *          <0 for no memory
+ */
+int limregex_capture_search( const char[], const struct limregex_capture *,    int[] );
+
+/*  Search a tagged NFA anywhere in a buffer, '\0' is
+ *  a character.
+ *  Input:  Buffer,
+ *          Buffer length,
+ *          Tagged NFA,
+ *          Array of 2*(groups+1) int to store the spans
+ *  Output: Length of the leftmost longest match,
+ *          <0 for no memory
+ */
+int limregex_capture_search_n( const char[],   size_t, const struct limregex_capture *,    int[] );
+
+/*  RegExp compiled to native code, x86-64 code of the
+ *  DFA, or VM instructions on other machines.  */
+struct limregex_jit;
+
+/*  Compile a Regular Expression to native code in
+ *  executable pages.
+ *  Input:  RegExp string
+ *  Output: Compiled RegExp, NULL for malformed RegExp,
+ *          threads may share it
+ */
+struct limregex_jit *limregex_jit_compile( const char[] );
+
+/*  Compile a Regular Expression in a buffer to native
+ *  code, '\0' is a character.
+ *  Input:  RegExp buffer,
+ *          Buffer length
+ *  Output: Compiled RegExp, NULL for malformed RegExp
+ */
+struct limregex_jit *limregex_jit_compile_n( const char[], size_t  );
+
+/*  Free a RegExp of limregex_jit_compile().
+ *  Input:  Compiled RegExp
+ */
+void limregex_jit_free( struct limregex_jit * );
+
+/*  Input:  Compiled RegExp
+ *  Output: 1 for native code, 0 for VM instructions
+ */
+int limregex_jit_native( const struct limregex_jit * );
+
+/*  Execute native code, the same as limregexec().
+ *  Input:  String,
+ *          Compiled RegExp
+ *  Output: Match Length
+ */
+int limregex_jit_exec( const char[],   const struct limregex_jit * );
+
+/*  Execute native code on a buffer, '\0' is
+ *  a character.
+ *  Input:  Buffer,
+ *          Buffer length,
+ *          Compiled RegExp
+ *  Output: Match Length
+ */
+int limregex_jit_exec_n( const char[], size_t, const struct limregex_jit * );
+
+/*  Execute native code on a buffer in a match mode,
+ *  '\0' is a character.
+ *  Input:  Buffer,
+ *          Buffer length,
+ *          Compiled RegExp,
+ *          Match mode
+ *  Output: Match Length, or 1 for LIMREGEX_IS_MATCH
+ */
+int limregex_jit_exec_mode_n( const char[],    size_t, const struct limregex_jit *,    int );
+
+/*  Kinds of saved compiled programs   */
+enum limregex_kind{
+    LIMREGEX_VM = 1,
+    LIMREGEX_TABLE
+};
+
+/*  Save a compiled program with a header, programs
+ *  saved one after another make a bundle.
+ *  Input:  Buffer to store the saved program,
+ *          Buffer size,
+ *          Compiled VM instructions or table,
+ *          Number of int of the program,
+ *          LIMREGEX_VM or LIMREGEX_TABLE
+ *  Output: Number of bytes used, <0 for no enough space
+ */
+long limregex_save( char[],    size_t, const int[],    int,    int );
+
+/*  Load a saved program in place, no copy is made.
+ *  Input:  Saved program, int aligned, such as mmap()ed,
+ *          Bytes from above to the end of the buffer,
+ *          Pointer to store the kind of the program,
+ *          Pointer to store the bytes of the saved program
+ *  Output: The program in the buffer, NULL for a bad
+ *          header or a program of another build
+ */
+const int *limregex_load( const char[],    size_t, int *,  size_t * );
+
+/*  Counters of the compiled program cache.
+ *  hits:       Programs found in the cache
+ *  misses:     Programs compiled
+ *  evictions:  Programs dropped for the byte budget
+ *  bytes:      Bytes of programs in the cache
+ *  entries:    Number of programs in the cache
+ */
+struct limregex_cache_stats{
+    long long hits;
+    long long misses;
+    long long evictions;
+    size_t bytes;
+    int entries;
+};
+
+/*  Compile a Regular Expression through the process-wide
+ *  cache, thread-safe.
+ *  Input:  RegExp string,
+ *          LIMREGEX_VM or LIMREGEX_TABLE
+ *  Output: The compiled program, NULL for malformed RegExp,
+ *          keep it until limregex_cache_put()
+ */
+const int *limregex_cache_get( const char[],   int );
+
+/*  Compile a Regular Expression in a buffer through the
+ *  cache, '\0' is a character.
+ *  Input:  RegExp buffer,
+ *          Buffer length,
+ *          LIMREGEX_VM or LIMREGEX_TABLE
+ *  Output: The compiled program, NULL for malformed RegExp
+ */
+const int *limregex_cache_get_n( const char[], size_t, int );
+
+/*  Give back a program of limregex_cache_get().
+ *  Input:  The compiled program
+ */
+void limregex_cache_put( const int * );
+
+/*  Set the byte budget of the cache, least recently
+ *  used programs are dropped past it.
+ *  Input:  Bytes, 0 to empty the cache
+ */
+void limregex_cache_budget( size_t );
+
+/*  Read the counters of the cache.
+ *  Input:  Pointer to store the counters
+ */
+void limregex_cache_report( struct limregex_cache_stats * );
+
+/*  Byte equivalence classes of a compiled table.
+ *  Input:  Array of table,
+ *          Array of 256 to store class of each byte, or NULL
+ *  Output: Number of classes
+ */
+int limregex_table_classes( const int[],    unsigned char[] );
 
 #endif